@@ -0,0 +1,168 @@
+//
+// Created by satopja2 on 17.10.26.
+//
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../src/http/Scanner.h"
+
+using namespace std;
+
+/**
+ * Class measuring how fast Scanner implementations split request heads compared to scalar search with
+ * string_view, which request parser used before.
+ * @note Benchmark is built with the same flags as server. Every implementation tokenizes request heads the same
+ * way RequestParser does (spaces in request line, colon and line end of every header, empty line), all of them
+ * have to find the same delimiters.
+ */
+class ScannerBenchmark {
+    public:
+        /**
+         * Runs benchmark of all implementations available on current CPU and prints results.
+         * @param[in] iterations Number of passes over all request heads.
+         * @return true if all implementations found the same delimiters, false otherwise.
+         */
+        static bool run(const size_t &iterations) noexcept;
+    private:
+        /** Type of function searching data for first of two characters. */
+        using find_function = size_t (*)(const char*, size_t, size_t, char, char);
+        /**
+         * Builds request head with given number of headers, values are long like cookies of real browsers.
+         * @param[in] headers Number of headers.
+         * @param[in] value_length Length of header values.
+         * @return Request head including empty line.
+         */
+        static string build_head(const size_t &headers, const size_t &value_length) noexcept;
+        /**
+         * Scalar search using string_view::find_first_of().
+         */
+        static size_t find_string_view(const char *data, size_t length, size_t pos, char first,
+                char second) noexcept;
+        /**
+         * Finds all delimiters of request head and sums their positions, so calls cannot be optimized away.
+         * @param[in] find Implementation used for searching.
+         * @param[in] head Request head.
+         * @return Sum of positions of all found delimiters.
+         */
+        static size_t tokenize(const find_function &find, const string_view &head) noexcept;
+        /**
+         * Measures implementation on all request heads and prints time of one pass over them and throughput.
+         * @param[in] name Name of implementation.
+         * @param[in] find Implementation used for searching.
+         * @param[in] heads Request heads.
+         * @param[in] iterations Number of passes over all request heads.
+         * @param[out] checksum Sum of positions of all found delimiters in one pass.
+         */
+        static void measure(const char *name, const find_function &find, const vector<string> &heads,
+                const size_t &iterations, size_t &checksum) noexcept;
+};
+
+bool ScannerBenchmark::run(const size_t &iterations) noexcept {
+    vector<string> heads = {build_head(4, 16), build_head(12, 64), build_head(20, 400)};
+    size_t expected = 0, checksum = 0;
+    bool is_valid = true;
+
+    printf("request heads: %zu, %zu and %zu bytes, %zu iterations\n", heads[0].length(), heads[1].length(),
+            heads[2].length(), iterations);
+    measure("string_view", find_string_view, heads, iterations, expected);
+    measure("scalar", Scanner::find_scalar, heads, iterations, checksum);
+    is_valid = is_valid && checksum == expected;
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) {
+        measure("sse4.2", Scanner::find_sse42, heads, iterations, checksum);
+        is_valid = is_valid && checksum == expected;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        measure("avx2", Scanner::find_avx2, heads, iterations, checksum);
+        is_valid = is_valid && checksum == expected;
+    }
+#endif
+    measure("selected", Scanner::find_impl, heads, iterations, checksum);
+    is_valid = is_valid && checksum == expected;
+
+    return is_valid;
+}
+
+string ScannerBenchmark::build_head(const size_t &headers, const size_t &value_length) noexcept {
+    string head = "GET /static/images/logo.png?version=20261017 HTTP/1.1\r\n";
+
+    for (size_t header = 0; header < headers; ++header)
+        head += "X-Header-" + to_string(header) + ": " + string(value_length, 'a' + header % 26) + "\r\n";
+    head += "\r\n";
+
+    return head;
+}
+
+size_t ScannerBenchmark::find_string_view(const char *data, size_t length, size_t pos, char first,
+        char second) noexcept {
+    const char delimiters[] = {first, second};
+    return string_view(data, length).find_first_of(string_view(delimiters, 2), pos);
+}
+
+size_t ScannerBenchmark::tokenize(const find_function &find, const string_view &head) noexcept {
+    size_t checksum = 0, pos = 0, pos_end = 0;
+
+    // Request line
+    pos_end = find(head.data(), head.length(), pos, '\r', '\r');
+    for (size_t word = 0; word < 2; ++word) {
+        pos = find(head.data(), pos_end, pos, ' ', ' ') + 1;
+        checksum += pos;
+    }
+    pos = pos_end + 2;
+
+    // Headers until empty line
+    while (pos < head.length()) {
+        pos_end = find(head.data(), head.length(), pos, ':', '\r');
+        checksum += pos_end;
+        if (head[pos_end] == '\r')
+            break;
+        pos_end = find(head.data(), head.length(), pos_end + 1, '\r', '\r');
+        checksum += pos_end;
+        pos = pos_end + 2;
+    }
+
+    return checksum;
+}
+
+void ScannerBenchmark::measure(const char *name, const find_function &find, const vector<string> &heads,
+        const size_t &iterations, size_t &checksum) noexcept {
+    size_t bytes = 0;
+    volatile size_t sink = 0;
+
+    checksum = 0;
+    for (const auto &head : heads) {
+        checksum += tokenize(find, head);
+        bytes += head.length();
+    }
+
+    auto start = chrono::steady_clock::now();
+    for (size_t iteration = 0; iteration < iterations; ++iteration)
+        for (const auto &head : heads)
+            sink = sink + tokenize(find, head);
+    chrono::duration<double> duration = chrono::steady_clock::now() - start;
+
+    printf("%-12s %10.1f ns/pass %8.3f GB/s\n", name, duration.count() * 1e9 / iterations,
+            bytes * iterations / duration.count() / 1e9);
+    return;
+}
+
+int main(int argc, char *argv[]) {
+    size_t iterations = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 100000;
+
+    if (iterations == 0) {
+        fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+        return 1;
+    }
+    if (!ScannerBenchmark::run(iterations)) {
+        fprintf(stderr, "Implementations found different delimiters\n");
+        return 1;
+    }
+
+    return 0;
+}
@@ -2,46 +2,92 @@
 // Created by satopja2 on 12.03.20.
 //
 
+#include <cerrno>
 #include <stdexcept>
 #include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "DirectoryGenerator.h"
 
 
-string DirectoryGenerator::get_body(bool &is_text_file) {
-    DIR *directory;
-    struct dirent *dir_entry;
+DirectoryGenerator::~DirectoryGenerator() {
+    if (m_directory != NULL)
+        closedir(m_directory);
+    return;
+}
 
-    // Try to open directory
-    directory = opendir(m_path.get_absolute().c_str());
-    if (directory == NULL)
+void DirectoryGenerator::open_stream() {
+    // Directory known only from its status is opened beneath root like any other
+    if (m_path.get_file() == nullptr && !m_path.reopen_at(m_root_fd))
         throw runtime_error("unable to open directory");
 
-    // Prepare HTML of directory listing
-    string title = "Index of " + m_path.get_http();
-    m_body = "<html><head><meta charset=\"UTF-8\"><title>" + title + "</title></head><body>";
-    m_body += "<h1>" + title + "</h1>";
+    // Directory is read through its own open file description
+    int fd = openat(m_path.get_file()->get(), ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    m_directory = (fd >= 0) ? fdopendir(fd) : NULL;
+    if (fd >= 0 && m_directory == NULL)
+        close(fd);
+    if (m_directory == NULL)
+        throw runtime_error("unable to open directory");
+
+    m_state = LISTING_HEADER;
+    return;
+}
+
+Generator::stream_status DirectoryGenerator::read_stream(string &chunk) noexcept {
+    struct dirent *dir_entry;
+    size_t chunk_start = chunk.length();
+
+    switch (m_state) {
+        case LISTING_CLOSED:
+            return STREAM_ERROR;
+        case LISTING_FINISHED:
+            return STREAM_END;
+        case LISTING_HEADER: {
+            // Prepare HTML of directory listing
+            string title = "Index of " + m_path.get_http();
+            chunk += "<html><head><meta charset=\"UTF-8\"><title>" + title + "</title></head><body>";
+            chunk += "<h1>" + title + "</h1>";
+            m_state = LISTING_ENTRIES;
+            break;
+        }
+        case LISTING_ENTRIES:
+            break;
+    }
 
-    // Append HTML anchor for every file in directory
+    // Append HTML anchor for every file in directory until chunk is large enough
     try {
-        while ((dir_entry = readdir(directory)))
-            append_anchor(dir_entry);
+        errno = 0;
+        while ((chunk.length() - chunk_start) < Generator::chunk_size && (dir_entry = readdir(m_directory))) {
+            append_anchor(dir_entry, dirfd(m_directory), chunk);
+            errno = 0;
+        }
     } catch (const exception& e) {
-        throw runtime_error(e.what());
+        return STREAM_ERROR;
     }
+    if ((chunk.length() - chunk_start) >= Generator::chunk_size)
+        return STREAM_DATA;
+    if (errno != 0)
+        return STREAM_ERROR;
 
     // Close HTML
-    m_body += "</body></html>";
-
-    if (closedir(directory) < 0)
-        throw runtime_error("unable to close directory");
+    chunk += "</body></html>";
+    m_state = LISTING_FINISHED;
+    if (closedir(m_directory) < 0) {
+        m_directory = NULL;
+        return STREAM_ERROR;
+    }
+    m_directory = NULL;
 
-    return m_body;
+    return STREAM_DATA;
 }
 
-void DirectoryGenerator::append_anchor(struct dirent *dir_entry) {
+void DirectoryGenerator::append_anchor(struct dirent *dir_entry, const int &dir_fd, string &chunk) {
     Path entry(m_path);
     string filename, href, type;
+    struct stat entry_status;
+    unsigned char entry_type = dir_entry->d_type;
 
     // Construct absolute path to directory entry
     entry = m_path.get_http() + "/" + dir_entry->d_name;
@@ -54,15 +100,22 @@ void DirectoryGenerator::append_anchor(struct dirent *dir_entry) {
     // Set different link for server root
     href = (m_path.get_http() == "/") ? ("/" + filename) : (m_path.get_http() + "/" + filename);
 
+    // Type is usually known from directory itself, symbolic links are followed
+    if (entry_type == DT_UNKNOWN || entry_type == DT_LNK) {
+        entry_type = DT_UNKNOWN;
+        if (fstatat(dir_fd, dir_entry->d_name, &entry_status, 0) == 0)
+            entry_type = S_ISDIR(entry_status.st_mode) ? DT_DIR : (S_ISREG(entry_status.st_mode) ? DT_REG : DT_UNKNOWN);
+    }
+
     // Set file type in listing
     type = "[other]  ";
-    if (entry.is_directory())
+    if (entry_type == DT_DIR)
         type = "[dir]    ";
-    if (entry.is_regular())
+    if (entry_type == DT_REG)
         type = "[file]   ";
 
     // Append anchor to HTML
-    m_body += type + "<a href=\"" + href + "\">" + filename + "</a><br/>";
+    chunk += type + "<a href=\"" + href + "\">" + filename + "</a><br/>";
 
     return;
 }
\ No newline at end of file
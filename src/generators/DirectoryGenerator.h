@@ -5,6 +5,8 @@
 #ifndef EIRSERVER_DIRECTORY_GENERATOR_H
 #define EIRSERVER_DIRECTORY_GENERATOR_H
 
+#include <dirent.h>
+
 #include "Generator.h"
 
 using namespace std;
@@ -15,26 +17,60 @@ using namespace std;
 class DirectoryGenerator: public Generator {
     public:
         /**
-         * Calls Generator().
+         * Calls Generator() and sets root directory beneath which listed directory is opened (m_root_fd).
          * @param[in] path Absolute path to file from which we generate body.
+         * @param[in] root_fd Open root directory file descriptor.
          * @see Generator
          */
-        DirectoryGenerator(const Path &path): Generator(path) {}
+        DirectoryGenerator(const Path &path, const int &root_fd): Generator(path), m_root_fd(root_fd),
+            m_directory(NULL), m_state(LISTING_CLOSED) {}
+        /**
+         * Closes listed directory if it is still open.
+         */
+        virtual ~DirectoryGenerator();
+        /**
+         * Listing is generated while it is being sent, so large directories do not need to fit to memory.
+         * @return true
+         */
+        virtual bool is_streamed() const noexcept override { return true; }
         /**
-         * Generates HTML listing for given directory.
-         * @param[in] is_text_file Ignored.
-         * @return String containing data to be appended to HTTP response body.
-         * @throw runtime_error If it cannot open or close the directory.
+         * Opens listed directory (m_directory), directory known only from its status is opened by
+         * Path::reopen_at() first.
+         * @throw runtime_error If it cannot open the directory.
+         */
+        virtual void open_stream() override;
+        /**
+         * Generates next part of HTML listing of directory, at least chunk_size bytes unless listing ends.
+         * @param[out] chunk Next part of listing.
+         * @return STREAM_DATA if part of listing was appended, STREAM_END if whole listing was generated,
+         * STREAM_ERROR if directory cannot be read. Reading directory never waits.
          * @see append_anchor()
          */
-        virtual string get_body(bool &is_text_file) override;
+        virtual stream_status read_stream(string &chunk) noexcept override;
     private:
         /**
-         * Appends HTML anchor to m_body constructed from given directory entry.
+         * Enum holding which part of listing is generated next.
+         */
+        enum listing_state {
+            LISTING_CLOSED,
+            LISTING_HEADER,
+            LISTING_ENTRIES,
+            LISTING_FINISHED
+        };
+        /** Member holding root directory file descriptor. */
+        int m_root_fd;
+        /** Member holding listed directory. */
+        DIR *m_directory;
+        /** Member holding which part of listing is generated next. */
+        listing_state m_state;
+        /**
+         * Appends HTML anchor constructed from given directory entry. File type is taken from directory
+         * entry, only symbolic links and entries of unknown type are checked by fstatat().
          * @param[in] dir_entry Pointer to directory entry.
-         * @throw runtime_error If it cannot check status of the given file.
+         * @param[in] dir_fd File descriptor of listed directory.
+         * @param[out] chunk Listing to which anchor is appended.
          */
-        void append_anchor(struct dirent *dir_entry);
+        void append_anchor(struct dirent *dir_entry, const int &dir_fd, string &chunk);
 };
 
 
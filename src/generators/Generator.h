@@ -6,13 +6,18 @@
 #define EIRSERVER_GENERATOR_H
 
 #include <string>
+#include <memory>
+#include <sys/types.h>
 
 #include "../server/Path.h"
+#include "../server/FileDescriptor.h"
 
 using namespace std;
 
 /**
  * Abstract class for response body generators.
+ * @note Generator either opens file which is sent as it is (get_file()) or streams body in parts
+ * (open_stream() and read_stream()), so the whole body never needs to be held in memory.
  */
 class Generator {
     public:
@@ -26,13 +31,56 @@ class Generator {
          */
         virtual ~Generator() = default;
         /**
-         * Pure virtual function. Gets body data from file in m_path.
-         * @return String containing data to be appended to HTTP response body.
+         * Enum holding results of reading next part of streamed body.
          */
-        virtual string get_body(bool &is_text_file) = 0;
+        enum stream_status {
+            STREAM_DATA,
+            STREAM_AGAIN,
+            STREAM_END,
+            STREAM_ERROR
+        };
+        /**
+         * Opens file in m_path, so it can be sent as response body without reading it to memory.
+         * @param[out] is_text_file Whether opened file looks like text file.
+         * @param[out] size Size of opened file.
+         * @return Pointer to open file. Nullptr if body is streamed.
+         */
+        virtual shared_ptr<FileDescriptor> get_file(bool &is_text_file, off_t &size) { return nullptr; }
+        /**
+         * Checks if generated body is plain contents of file in m_path, which may be kept in ContentCache.
+         * @return true if body may be cached, false otherwise.
+         */
+        virtual bool is_cacheable() const noexcept { return false; }
+        /**
+         * Checks if body is generated in parts by read_stream() and its length is not known in advance.
+         * @return true if body is streamed, false otherwise.
+         */
+        virtual bool is_streamed() const noexcept { return false; }
+        /**
+         * Starts generating streamed body, for example opens directory or starts script.
+         * @throw runtime_error If body cannot be generated.
+         */
+        virtual void open_stream() {}
+        /**
+         * Gets next part of streamed body without blocking.
+         * @param[out] chunk Next part of body, appended to given string.
+         * @return STREAM_DATA if chunk was appended, STREAM_AGAIN if data are not available yet (get_stream_fd()
+         * becomes readable once they are), STREAM_END if whole body was read, STREAM_ERROR if body cannot be read.
+         */
+        virtual stream_status read_stream(string &chunk) noexcept { return STREAM_END; }
+        /**
+         * Gets file descriptor which becomes readable when more streamed data are available.
+         * @return Int representing file descriptor, -1 if stream never waits.
+         */
+        virtual int get_stream_fd() const noexcept { return -1; }
+        /**
+         * Gets path to file from which we generate body (m_path).
+         * @return Reference to path of file.
+         */
+        const Path& get_path() const noexcept { return m_path; }
     protected:
-        /** Member holding HTTP response body data. */
-        string m_body;
+        /** Static member holding size of body part after which streamed body should be sent. */
+        static const size_t chunk_size = 16384;
         /** Absolute path to file from which we generate body. */
         Path m_path;
 };
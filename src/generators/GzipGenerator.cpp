@@ -0,0 +1,45 @@
+//
+// Created by satopja2 on 17.10.26.
+//
+
+#include "GzipGenerator.h"
+
+void GzipGenerator::open_stream() {
+    m_generator->open_stream();
+    return;
+}
+
+Generator::stream_status GzipGenerator::read_stream(string &chunk) noexcept {
+    if (m_finished)
+        return STREAM_END;
+
+    m_input.clear();
+    switch (m_generator->read_stream(m_input)) {
+        case STREAM_DATA:
+            if (!m_compressor.compress(m_input, Compressor::FLUSH_NONE, chunk))
+                return STREAM_ERROR;
+            m_pending = true;
+            return STREAM_DATA;
+        case STREAM_AGAIN:
+            // Client gets everything generated so far before we wait for more
+            if (!m_pending)
+                return STREAM_AGAIN;
+            m_pending = false;
+            if (!m_compressor.compress("", Compressor::FLUSH_SYNC, chunk))
+                return STREAM_ERROR;
+            return STREAM_DATA;
+        case STREAM_END:
+            m_finished = true;
+            if (!m_compressor.compress("", Compressor::FLUSH_FINISH, chunk))
+                return STREAM_ERROR;
+            return STREAM_DATA;
+        case STREAM_ERROR:
+            break;
+    }
+
+    return STREAM_ERROR;
+}
+
+int GzipGenerator::get_stream_fd() const noexcept {
+    return m_generator->get_stream_fd();
+}
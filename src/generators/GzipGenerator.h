@@ -0,0 +1,70 @@
+//
+// Created by satopja2 on 17.10.26.
+//
+
+#ifndef EIRSERVER_GZIP_GENERATOR_H
+#define EIRSERVER_GZIP_GENERATOR_H
+
+#include <memory>
+#include <string>
+
+#include "Generator.h"
+#include "../http/Compressor.h"
+
+using namespace std;
+
+/**
+ * Generator type class compressing streamed body of another generator with gzip content coding.
+ * @note Compressed data are held back only while the other generator produces more data, so everything it
+ * generated reaches the client before we wait for its next part.
+ */
+class GzipGenerator: public Generator {
+    public:
+        /**
+         * Calls Generator() with path of compressed generator and sets compressed generator (m_generator).
+         * @param[in] generator Generator of streamed body to be compressed.
+         * @param[in] level Compression level from 1 (fastest) to 9 (best compression).
+         * @throw runtime_error If compression cannot be initialized.
+         * @see Generator
+         */
+        GzipGenerator(shared_ptr<Generator> generator, const int &level):
+            Generator(generator->get_path()), m_generator(move(generator)), m_compressor(level), m_pending(false),
+            m_finished(false) {}
+        /**
+         * Compressed body is streamed like body of compressed generator.
+         * @return true
+         */
+        virtual bool is_streamed() const noexcept override { return true; }
+        /**
+         * Starts generating streamed body of compressed generator.
+         * @throw runtime_error If body cannot be generated.
+         */
+        virtual void open_stream() override;
+        /**
+         * Reads next part of body from compressed generator and compresses it. Compressed data are flushed
+         * once compressed generator has no more data available, gzip trailer is produced once its body ends.
+         * @param[out] chunk Next part of compressed body, may be empty while zlib holds data back.
+         * @return STREAM_DATA if chunk was appended, STREAM_AGAIN if compressed generator has no data yet,
+         * STREAM_END if whole body was compressed, STREAM_ERROR if body cannot be read or compressed.
+         */
+        virtual stream_status read_stream(string &chunk) noexcept override;
+        /**
+         * Gets file descriptor on which compressed generator waits for data.
+         * @return Int representing file descriptor, -1 if stream never waits.
+         */
+        virtual int get_stream_fd() const noexcept override;
+    private:
+        /** Member holding generator of body being compressed. */
+        shared_ptr<Generator> m_generator;
+        /** Member holding gzip stream of compressed body. */
+        Compressor m_compressor;
+        /** Member holding last part of body read from m_generator. */
+        string m_input;
+        /** Member holding whether data compressed since last flush may still be held back by zlib. */
+        bool m_pending;
+        /** Member holding whether gzip trailer was already produced. */
+        bool m_finished;
+};
+
+
+#endif //EIRSERVER_GZIP_GENERATOR_H
@@ -2,40 +2,27 @@
 // Created by satopja2 on 12.03.20.
 //
 
-#include <fstream>
-#include <sstream>
-#include <vector>
 #include <stdexcept>
+#include <cstring>
+#include <unistd.h>
 
 #include "RegularGenerator.h"
 
-string RegularGenerator::get_body(bool &is_text_file) {
-    ifstream file;
-    ostringstream buffer;
+shared_ptr<FileDescriptor> RegularGenerator::get_file(bool &is_text_file, off_t &size) {
+    string buffer(m_is_text_range, '\0');
 
-    // Prepare file for reading
-    file.open(m_path.get_absolute(), ios::in | ios::binary);
-    if (!file.is_open())
+    // File known only from its status is opened beneath root like any other
+    if (m_path.get_file() == nullptr && !m_path.reopen_at(m_root_fd))
         throw runtime_error("unable to open file");
-
-    // Load file
-    buffer << file.rdbuf();
-    m_body = buffer.str();
+    auto file = m_path.get_file();
+    size = m_path.get_file_status().st_size;
 
     // Guess if the file is binary or not based on m_is_text_range bytes
-    size_t len = (m_body.length() < m_is_text_range) ? m_body.length() : m_is_text_range;
-    for (size_t i = 0; i < len; ++i) {
-        if (m_body[i] == 0) {
-            is_text_file = false;
-            break;
-        }
-    }
-
-    // Close file
-    file.clear();
-    file.close();
-    if (file.fail())
-        throw runtime_error("unable to close file");
+    ssize_t len = pread(file->get(), &buffer[0], m_is_text_range, 0);
+    if (len < 0)
+        throw runtime_error("unable to read file");
+    if (memchr(buffer.data(), 0, len) != nullptr)
+        is_text_file = false;
 
-    return m_body;
+    return file;
 }
\ No newline at end of file
@@ -15,21 +15,32 @@ using namespace std;
 class RegularGenerator: public Generator {
     public:
         /**
-         * Calls Generator().
+         * Calls Generator() and sets root directory beneath which file is opened (m_root_fd).
          * @param[in] path Absolute path to file from which we generate body.
+         * @param[in] root_fd Open root directory file descriptor.
          * @see Generator
          */
-        RegularGenerator(const Path &path): Generator(path) {}
+        RegularGenerator(const Path &path, const int &root_fd): Generator(path), m_root_fd(root_fd) {}
         /**
-         * Reads data from file as if it was binary file. It tries to guess if the file is binary or text
-         * and sets is_text_file appropriately.
-         * @return String containing data to be appended to HTTP response body.
+         * Opens file for reading by Path::reopen_at() (unless it was already opened by Path::open_at()), gets its
+         * size and tries to guess if the file is binary or text and sets is_text_file appropriately.
+         * @param[out] is_text_file Whether opened file looks like text file.
+         * @param[out] size Size of opened file.
+         * @return Pointer to open file.
          * @throw runtime_error If it cannot access the file.
          * @note It tries to guess if file is text or binary by looking at first m_is_text_range bytes and checking if
-         * it contains null bytes. Same heuristic is used for example by grep and less.
+         * it contains null bytes. Same heuristic is used for example by grep and less. Only these bytes are read,
+         * rest of the file is sent by sendfile() straight from page cache.
          */
-        virtual string get_body(bool &is_text_file) override;
+        virtual shared_ptr<FileDescriptor> get_file(bool &is_text_file, off_t &size) override;
+        /**
+         * Regular files are sent as they are, so their contents may be cached.
+         * @return true
+         */
+        virtual bool is_cacheable() const noexcept override { return true; }
     private:
+        /** Member holding root directory file descriptor. */
+        int m_root_fd;
         /** Member holding how many bytes should be checked while guessing if given file is binary or text. */
         const size_t m_is_text_range = 1024;
 };
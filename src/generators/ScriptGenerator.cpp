@@ -2,32 +2,141 @@
 // Created by satopja2 on 12.03.20.
 //
 
-#include <cstdio>
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
 #include <stdexcept>
+#include <fcntl.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/wait.h>
 
 #include "ScriptGenerator.h"
 
-string ScriptGenerator::get_body(bool &is_text_file) {
-    FILE* pipe;
-    const size_t buffer_size = 512;
-    char buffer[buffer_size];
-    string exec = "exec " + m_path.get_absolute();
+extern char **environ;
 
-    // Open pipe to script file
-    if ((pipe = popen(exec.c_str(), "r")) == NULL)
+mutex ScriptGenerator::s_killed_lock;
+
+vector<pid_t> ScriptGenerator::s_killed;
+
+ScriptGenerator::~ScriptGenerator() {
+    if (m_pipe_fd >= 0)
+        close(m_pipe_fd);
+    if (m_pid > 0)
+        release();
+    return;
+}
+
+void ScriptGenerator::open_stream() {
+    int pipe_fds[2];
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attributes;
+    string path = m_path.get_absolute();
+    // Script is executed by shell like popen() would do, but its path is passed as argument
+    char *argv[] = {const_cast<char*>("sh"), const_cast<char*>("-c"), const_cast<char*>("exec \"$0\""),
+            const_cast<char*>(path.c_str()), nullptr};
+
+    // Open pipe to script file, only our end is non-blocking
+    if (pipe2(pipe_fds, O_CLOEXEC) < 0)
+        throw runtime_error("unable to open pipe");
+    if (fcntl(pipe_fds[0], F_SETFL, O_NONBLOCK) < 0 || posix_spawn_file_actions_init(&actions) != 0) {
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
         throw runtime_error("unable to open pipe");
+    }
+    if (posix_spawnattr_init(&attributes) != 0) {
+        posix_spawn_file_actions_destroy(&actions);
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        throw runtime_error("unable to run script");
+    }
 
-    // Read script file output
-    while (!feof(pipe)) {
-        if (ferror(pipe) != 0)
-            throw runtime_error("unable to read pipe");
-        if (fgets(buffer, buffer_size, pipe) != NULL)
-            m_body += buffer;
+    // Run script in its own process group with its output redirected to pipe, ignored SIGPIPE of server
+    // would be inherited, so script gets default one back
+    sigset_t default_signals;
+    sigemptyset(&default_signals);
+    sigaddset(&default_signals, SIGPIPE);
+    posix_spawn_file_actions_adddup2(&actions, pipe_fds[1], STDOUT_FILENO);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGDEF);
+    posix_spawnattr_setpgroup(&attributes, 0);
+    posix_spawnattr_setsigdefault(&attributes, &default_signals);
+    int spawn_val = posix_spawn(&m_pid, "/bin/sh", &actions, &attributes, argv, environ);
+    posix_spawnattr_destroy(&attributes);
+    posix_spawn_file_actions_destroy(&actions);
+    close(pipe_fds[1]);
+    if (spawn_val != 0) {
+        m_pid = -1;
+        close(pipe_fds[0]);
+        throw runtime_error("unable to run script");
     }
+    m_pipe_fd = pipe_fds[0];
+
+    return;
+}
+
+Generator::stream_status ScriptGenerator::read_stream(string &chunk) noexcept {
+    ssize_t bytes_read = 0;
+    size_t length = chunk.length();
 
-    // Close pipe
-    if (pclose(pipe) == -1)
-        throw runtime_error("unable to close pipe");
+    if (m_pipe_fd < 0)
+        return STREAM_END;
+
+    // Read script file output available right now
+    for (;;) {
+        chunk.resize(length + Generator::chunk_size);
+        bytes_read = read(m_pipe_fd, &chunk[length], Generator::chunk_size);
+        chunk.resize(length + ((bytes_read > 0) ? bytes_read : 0));
+        if (bytes_read > 0)
+            return STREAM_DATA;
+        if (bytes_read < 0 && errno == EINTR)
+            continue;
+        if (bytes_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return STREAM_AGAIN;
+        break;
+    }
+    if (bytes_read < 0)
+        return STREAM_ERROR;
+
+    // Script closed its output, its response is complete
+    close(m_pipe_fd);
+    m_pipe_fd = -1;
+    release();
+
+    return STREAM_END;
+}
+
+int ScriptGenerator::get_stream_fd() const noexcept {
+    return m_pipe_fd;
+}
+
+void ScriptGenerator::reap_scripts() noexcept {
+    lock_guard<mutex> lock(s_killed_lock);
+
+    // Script is forgotten once it is reaped or it is not our child anymore
+    s_killed.erase(remove_if(s_killed.begin(), s_killed.end(), [](const pid_t &pid) {
+        return waitpid(pid, nullptr, WNOHANG) != 0;
+    }), s_killed.end());
+
+    return;
+}
+
+void ScriptGenerator::release() noexcept {
+    // Script which already exited is reaped, processes it started in background are left alone
+    if (waitpid(m_pid, nullptr, WNOHANG) != 0) {
+        m_pid = -1;
+        return;
+    }
+
+    // Script did not finish, kill it together with processes it started, process group cannot be reused
+    // until script is reaped
+    kill(-m_pid, SIGKILL);
+    try {
+        lock_guard<mutex> lock(s_killed_lock);
+        s_killed.push_back(m_pid);
+    } catch (const exception& e) {
+        // Killed script stays zombie
+    }
+    m_pid = -1;
 
-    return m_body;
-}
\ No newline at end of file
+    return;
+}
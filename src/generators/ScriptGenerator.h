@@ -5,6 +5,10 @@
 #ifndef EIRSERVER_SCRIPT_GENERATOR_H
 #define EIRSERVER_SCRIPT_GENERATOR_H
 
+#include <mutex>
+#include <vector>
+#include <sys/types.h>
+
 #include "Generator.h"
 
 using namespace std;
@@ -19,14 +23,56 @@ class ScriptGenerator: public Generator {
          * @param[in] path Absolute path to file from which we generate body.
          * @see Generator
          */
-        ScriptGenerator(const Path &path): Generator(path) {}
+        ScriptGenerator(const Path &path): Generator(path), m_pipe_fd(-1), m_pid(-1) {}
+        /**
+         * Closes pipe and kills script with processes it started if it is still running, so it does not outlive
+         * its response. Killed script is reaped later by reap_scripts(), so destructor never waits.
+         */
+        virtual ~ScriptGenerator();
+        /**
+         * Output of script is sent while script is running, so client does not wait for script to finish.
+         * @return true
+         */
+        virtual bool is_streamed() const noexcept override { return true; }
+        /**
+         * Runs shell script with its output redirected to non-blocking pipe (m_pipe_fd).
+         * @throw runtime_error If the pipe cannot be opened or script cannot be run.
+         */
+        virtual void open_stream() override;
+        /**
+         * Reads output of script available in pipe. Once script closes its output, script which is still running
+         * is killed with processes it started, it is reaped without waiting by release().
+         * @param[out] chunk Next part of script output.
+         * @return STREAM_DATA if output was appended, STREAM_AGAIN if script did not write anything yet,
+         * STREAM_END if script closed its output, STREAM_ERROR if pipe cannot be read.
+         */
+        virtual stream_status read_stream(string &chunk) noexcept override;
+        /**
+         * Gets pipe with script output (m_pipe_fd).
+         * @return Int representing pipe file descriptor.
+         */
+        virtual int get_stream_fd() const noexcept override;
+        /**
+         * Reaps killed scripts which did not exit yet when they were released, so they do not stay zombies.
+         * Called regularly by workers, never waits.
+         */
+        static void reap_scripts() noexcept;
+    private:
+        /** Static member guarding s_killed. */
+        static mutex s_killed_lock;
+        /** Static member holding process IDs of killed scripts which were not reaped yet. */
+        static vector<pid_t> s_killed;
+        /** Member holding read end of pipe with script output. */
+        int m_pipe_fd;
+        /** Member holding process ID of running script. */
+        pid_t m_pid;
         /**
-         * Opens pipe to given shell script and reads its output.
-         * @param[in] is_text_file Ignored.
-         * @return String containg data to be appended to HTTP response body.
-         * @throw runtime_error If the pipe cannot be opened.
+         * Reaps script if it already exited, otherwise kills it with processes it started and leaves it to
+         * reap_scripts(). Sets m_pid to -1.
+         * @note Script is never waited for, so script which closed its output and keeps running, or is stuck
+         * in kernel, cannot block worker.
          */
-        virtual string get_body(bool &is_text_file) override;
+        void release() noexcept;
 };
 
 
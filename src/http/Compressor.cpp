@@ -0,0 +1,46 @@
+//
+// Created by satopja2 on 17.10.26.
+//
+
+#include <stdexcept>
+
+#include "Compressor.h"
+
+Compressor::Compressor(const int &level): m_stream() {
+    // Window bits above 15 select gzip wrapper instead of zlib one
+    if (deflateInit2(&m_stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        throw runtime_error("unable to initialize compression");
+    return;
+}
+
+Compressor::~Compressor() {
+    deflateEnd(&m_stream);
+    return;
+}
+
+bool Compressor::compress(const string_view &data, const flush_mode &flush, string &compressed) noexcept {
+    int deflate_val = Z_OK, zlib_flush = Z_NO_FLUSH;
+    size_t length = 0;
+
+    if (flush == FLUSH_SYNC)
+        zlib_flush = Z_SYNC_FLUSH;
+    else if (flush == FLUSH_FINISH)
+        zlib_flush = Z_FINISH;
+
+    m_stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    m_stream.avail_in = data.length();
+
+    // Compress directly to the end of output until zlib has nothing more to produce
+    do {
+        length = compressed.length();
+        compressed.resize(length + Compressor::output_step);
+        m_stream.next_out = reinterpret_cast<Bytef*>(&compressed[length]);
+        m_stream.avail_out = Compressor::output_step;
+        deflate_val = deflate(&m_stream, zlib_flush);
+        compressed.resize(length + Compressor::output_step - m_stream.avail_out);
+        if (deflate_val == Z_STREAM_ERROR)
+            return false;
+    } while (m_stream.avail_out == 0 || m_stream.avail_in > 0);
+
+    return flush != FLUSH_FINISH || deflate_val == Z_STREAM_END;
+}
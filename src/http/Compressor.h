@@ -0,0 +1,65 @@
+//
+// Created by satopja2 on 17.10.26.
+//
+
+#ifndef EIRSERVER_COMPRESSOR_H
+#define EIRSERVER_COMPRESSOR_H
+
+#include <string>
+#include <string_view>
+#include <zlib.h>
+
+using namespace std;
+
+/**
+ * Class compressing HTTP response body with gzip content coding using zlib.
+ * @note One compressor produces one gzip stream, data may be compressed at once or in parts as they are generated.
+ */
+class Compressor {
+    public:
+        /**
+         * Initializes zlib stream (m_stream) producing gzip format.
+         * @param[in] level Compression level from 1 (fastest) to 9 (best compression).
+         * @throw runtime_error If zlib stream cannot be initialized.
+         */
+        Compressor(const int &level);
+        /**
+         * Frees zlib stream.
+         */
+        ~Compressor();
+        /**
+         * Copying would free the same zlib stream twice.
+         */
+        Compressor(const Compressor &) = delete;
+        /**
+         * Copying would free the same zlib stream twice.
+         */
+        Compressor& operator =(const Compressor &) = delete;
+        /**
+         * Enum holding how much of compressed data has to be produced.
+         */
+        enum flush_mode {
+            /** Compressed data may be held back until more data come. */
+            FLUSH_NONE,
+            /** All compressed data have to be produced, so client can decompress everything received so far. */
+            FLUSH_SYNC,
+            /** All compressed data and gzip trailer have to be produced, nothing can be compressed after it. */
+            FLUSH_FINISH
+        };
+        /**
+         * Compresses data and appends produced part of gzip stream.
+         * @param[in] data Data to be compressed.
+         * @param[in] flush How much of compressed data has to be produced.
+         * @param[out] compressed Compressed data, appended to given string.
+         * @return true if data were compressed, false on zlib error.
+         */
+        bool compress(const string_view &data, const flush_mode &flush, string &compressed) noexcept;
+    private:
+        /** Static member holding by how many bytes is output grown before deflate(). */
+        static const size_t output_step = 16384;
+        /** Member holding zlib stream state. */
+        z_stream m_stream;
+};
+
+
+#endif //EIRSERVER_COMPRESSOR_H
@@ -27,6 +27,8 @@ class HttpConstants {
         // 2xx implemented codes
         /** HTTP response code "200 Ok" */
         static constexpr const char* CODE_OK = "200 Ok";
+        /** HTTP response code "206 Partial Content" */
+        static constexpr const char* CODE_PARTIAL_CONTENT = "206 Partial Content";
 
         // 3xx implemented codes
         /** HTTP response code "304 Not Modified" */
@@ -37,6 +39,12 @@ class HttpConstants {
         static constexpr const char* CODE_BAD_REQUEST = "400 Bad Request";
         /** HTTP response code "404 Not Found" */
         static constexpr const char* CODE_NOT_FOUND = "404 Not Found";
+        /** HTTP response code "408 Request Timeout" */
+        static constexpr const char* CODE_REQUEST_TIMEOUT = "408 Request Timeout";
+        /** HTTP response code "416 Range Not Satisfiable" */
+        static constexpr const char* CODE_RANGE_NOT_SATISFIABLE = "416 Range Not Satisfiable";
+        /** HTTP response code "431 Request Header Fields Too Large" */
+        static constexpr const char* CODE_HEADERS_TOO_LARGE = "431 Request Header Fields Too Large";
 
         // 5xx implemented codes
         /** HTTP response code "500 Internal Server Error" */
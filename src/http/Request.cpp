@@ -2,33 +2,42 @@
 // Created by satopja2 on 10.03.20.
 //
 
-#include <sstream>
-#include <iterator>
+#include <algorithm>
+#include <cerrno>
 #include <csignal>
+#include <cstdlib>
 #include <stdexcept>
+#include <strings.h>
 
 #include "Request.h"
+#include "../server/Clock.h"
 #include "../server/Server.h"
 #include "../generators/RegularGenerator.h"
 #include "../generators/DirectoryGenerator.h"
 #include "../generators/ScriptGenerator.h"
+#include "../generators/GzipGenerator.h"
 
-string Request::handle(const string &request_data, const char ip[INET_ADDRSTRLEN]) noexcept {
-    m_request_data = request_data;
+const struct Request::encoding Request::encodings[2] = {{"br", ".br"}, {"gzip", ".gz"}};
+
+vector<Response::segment> Request::handle(const string_view &request_data, const char ip[INET_ADDRSTRLEN], const bool &keep_alive) noexcept {
+    m_start = chrono::steady_clock::now();
     m_ip = ip;
+    m_keep_alive = keep_alive;
     string error_message;
-
-    // Parse HTTP request data
-    parse();
-
-    // Invalid HTTP request
-    if (!m_file.path.is_valid() || m_version.empty() || m_method == HttpConstants::METHOD_ERROR) {
+    bool is_cacheable = false, is_parsed = false;
+    Cache::cache_status cache_status = Cache::NOT_FOUND;
+    vector<Response::segment> response;
+
+    // Parse HTTP request data, invalid HTTP request
+    is_parsed = parse(request_data);
+    m_parsed = chrono::steady_clock::now();
+    if (!is_parsed || !m_file.path.is_valid() || m_method == HttpConstants::METHOD_ERROR) {
         m_code = HttpConstants::CODE_BAD_REQUEST;
         return get_response();
     }
 
     // Unknown HTTP version
-    if (m_version != "HTTP/1.1") {
+    if (m_parser.get_version() != "HTTP/1.1") {
         m_code = HttpConstants::CODE_HTTP_VERSION;
         return get_response();
     }
@@ -41,18 +50,37 @@ string Request::handle(const string &request_data, const char ip[INET_ADDRSTRLEN
 
     // Shutdown requested
     if (m_file.path.get_http() == m_config->find_setting_val("off_address")) {
+        m_logger->log_message(Logger::WARNING, "Shutdown requsted");
         raise(SIGTERM);
-        return "";
+        return {};
+    }
+
+    // Metrics requested
+    if (!m_metrics_address.empty() && m_file.path.get_http() == m_metrics_address) {
+        m_code = HttpConstants::CODE_OK;
+        m_file.mime = "text/plain; version=0.0.4";
+        m_file.is_volatile = true;
+        m_response->set_body(m_metrics->render());
+        return get_response();
     }
 
-    // Nonexistent file
-    if (!m_file.path.exists()) {
+    // Nonexistent file, it is checked only once
+    if (!open_file(m_file.path)) {
         m_code = HttpConstants::CODE_NOT_FOUND;
         return get_response();
     }
+    choose_encoding();
+    choose_compression();
+
+    // Small file may be answered by response kept from earlier request
+    is_cacheable = is_response_cacheable();
+    if (is_cacheable && find_response(response))
+        return response;
 
     // Check cache
-    switch (m_cache->check_file(m_file.path.get_absolute(), m_file.etag)) {
+    cache_status = m_cache->check_file(get_cache_key(m_file.path), m_file.etag, m_file.path.get_file_status());
+    m_counters.count_cache(cache_status);
+    switch (cache_status) {
         case Cache::ERROR:
             error_message = m_file.path.get_absolute() + ": unable to check file cache status";
             m_logger->log_message(Logger::ERROR, error_message);
@@ -61,37 +89,83 @@ string Request::handle(const string &request_data, const char ip[INET_ADDRSTRLEN
             m_code = HttpConstants::CODE_NOT_MODIFIED;
             return get_response();
         case Cache::NOT_FOUND:
+        case Cache::EXPIRED:
             break;
     }
 
     construct_body();
+    response = get_response();
+    if (is_cacheable)
+        add_response(response);
+    return response;
+}
+
+vector<Response::segment> Request::handle_error(const string &code, const char ip[INET_ADDRSTRLEN]) noexcept {
+    m_start = chrono::steady_clock::now();
+    m_parsed = m_start;
+    m_ip = ip;
+    m_keep_alive = false;
+    m_code = code;
     return get_response();
 }
 
+bool Request::is_keep_alive() const noexcept {
+    return m_keep_alive;
+}
+
 void Request::reset() noexcept {
     m_response->reset();
-    m_request_data.clear();
+    m_parser.reset();
     m_ip.clear();
     m_method = HttpConstants::METHOD_ERROR;
-    m_version.clear();
+    m_keep_alive = false;
     m_file.path.clear();
     m_file.mime.clear();
     m_file.etag.clear();
+    m_file.range.clear();
+    m_file.if_range.clear();
+    m_file.accept_encoding.clear();
+    m_file.encoding.clear();
+    m_file.varies = false;
+    m_file.is_compressed = false;
+    m_file.is_volatile = false;
     m_code.clear();
 }
 
-string Request::get_response() noexcept {
-    string response;
+vector<Response::segment> Request::get_response() noexcept {
+    vector<Response::segment> response;
 
     m_response->set_method(m_method);
     m_response->set_code(m_code);
 
+    // Close connection after errors in request itself
+    if (m_code == HttpConstants::CODE_BAD_REQUEST || m_code == HttpConstants::CODE_HTTP_VERSION
+            || m_code == HttpConstants::CODE_NOT_IMPLEMENTED || m_code == HttpConstants::CODE_REQUEST_TIMEOUT
+            || m_code == HttpConstants::CODE_HEADERS_TOO_LARGE)
+        m_keep_alive = false;
+
+    // Set connection headers
+    if (m_keep_alive) {
+        m_response->set_header("Connection", "keep-alive");
+        m_response->set_header("Keep-Alive", "timeout=" + m_config->find_setting_val("keepalive_timeout"));
+    } else
+        m_response->set_header("Connection", "close");
+
     // Valid request mime type
-    if (m_code == HttpConstants::CODE_OK)
+    if (m_code == HttpConstants::CODE_OK || m_code == HttpConstants::CODE_PARTIAL_CONTENT)
         m_response->set_header("Content-Type", m_file.mime);
 
-    // Set cache control headers
-    if (m_cache->get_time() == 0)
+    // Precompressed or compressed variant of file was chosen by Accept-Encoding
+    if (m_code == HttpConstants::CODE_OK || m_code == HttpConstants::CODE_PARTIAL_CONTENT
+            || m_code == HttpConstants::CODE_NOT_MODIFIED) {
+        if (!m_file.encoding.empty())
+            m_response->set_header("Content-Encoding", m_file.encoding);
+        if (m_file.varies)
+            m_response->set_header("Vary", "Accept-Encoding");
+    }
+
+    // Set cache control headers, metrics would be stale when read from any cache
+    if (m_cache->get_time() == 0 || m_file.is_volatile)
         m_response->set_header("Cache-Control", "no-store");
     else {
         string cache_control_val = "public, max-age=" + to_string(m_cache->get_time());
@@ -101,7 +175,7 @@ string Request::get_response() noexcept {
     }
 
     response = m_response->construct();
-    m_logger->log_http(m_request_data, response, m_ip);
+    record_response(response.front().data, response);
 
     return response;
 }
@@ -118,25 +192,311 @@ unique_ptr<Generator> Request::get_generator() {
     // Directory requested
     if (m_file.path.is_directory()) {
         m_file.mime = "text/html";
-        Path index(m_file.path.get_absolute(), "/index.html");
-        if (index.exists() && index.is_regular()) {
-            generator = make_unique<RegularGenerator>(index);
+        Path index(m_file.path);
+        string directory = m_file.path.get_http();
+        index = directory + ((directory.back() == '/') ? "index.html" : "/index.html");
+        if (open_file(index) && index.is_regular()) {
+            generator = make_unique<RegularGenerator>(index, m_root_fd.get());
             return generator;
         }
-        generator = make_unique<DirectoryGenerator>(m_file.path);
+        generator = make_unique<DirectoryGenerator>(m_file.path, m_root_fd.get());
         return generator;
     }
 
     // Regular file requested
     if (m_file.path.is_regular())
-        generator = make_unique<RegularGenerator>(m_file.path);
+        generator = make_unique<RegularGenerator>(m_file.path, m_root_fd.get());
 
     return generator;
 }
 
+void Request::choose_encoding() noexcept {
+    const struct encoding *chosen = nullptr;
+    double chosen_quality = 0, quality = 0;
+
+    // Only plain files have precompressed variants, scripts are always run
+    if (!m_file.path.is_regular() || m_file.path.get_extension() == ".sh"
+            || m_config->find_setting_val("precompressed") != "on")
+        return;
+
+    string original = m_file.path.get_http();
+    for (const auto &coding : Request::encodings) {
+        quality = get_quality(m_file.accept_encoding, coding.name);
+        if (quality <= chosen_quality && m_file.varies)
+            continue;
+
+        // Variant has to be regular file too, otherwise original file is sent
+        Path variant(m_file.path);
+        variant = original + coding.extension;
+        if (!open_file(variant) || !variant.is_regular())
+            continue;
+
+        // Any variant makes response depend on Accept-Encoding, even if client does not accept it
+        m_file.varies = true;
+        if (quality <= chosen_quality)
+            continue;
+        m_file.path = variant;
+        chosen = &coding;
+        chosen_quality = quality;
+    }
+
+    if (chosen != nullptr)
+        m_file.encoding = chosen->name;
+    return;
+}
+
+double Request::get_quality(const string &accept_encoding, const string &coding) noexcept {
+    double quality = -1, any_quality = -1;
+
+    for (size_t start = 0, end = 0; start < accept_encoding.length(); start = end + 1) {
+        end = accept_encoding.find(',', start);
+        if (end == string::npos)
+            end = accept_encoding.length();
+
+        // Split list element to coding and its parameters
+        string element = accept_encoding.substr(start, end - start);
+        size_t params = element.find(';');
+        string name = element.substr(0, params);
+        name.erase(0, name.find_first_not_of(" \t"));
+        name.erase(name.find_last_not_of(" \t") + 1);
+
+        // Missing or invalid quality is taken as 1, value is clamped to valid range
+        double element_quality = 1;
+        while (params != string::npos) {
+            size_t param = element.find_first_not_of(" \t", params + 1);
+            params = element.find(';', params + 1);
+            if (param == string::npos || (element.compare(param, 2, "q=") != 0
+                    && element.compare(param, 2, "Q=") != 0))
+                continue;
+            char *number_end = nullptr;
+            double param_quality = strtod(element.c_str() + param + 2, &number_end);
+            if (number_end != element.c_str() + param + 2)
+                element_quality = min(max(param_quality, 0.0), 1.0);
+        }
+
+        if (strcasecmp(name.c_str(), coding.c_str()) == 0
+                || (coding == "gzip" && strcasecmp(name.c_str(), "x-gzip") == 0))
+            quality = max(quality, element_quality);
+        else if (name == "*")
+            any_quality = max(any_quality, element_quality);
+    }
+
+    if (quality >= 0)
+        return quality;
+    return max(any_quality, 0.0);
+}
+
+void Request::choose_compression() noexcept {
+    bool compressible = false;
+
+    // Disabled compression or precompressed variant was chosen
+    if (m_compression_level == 0 || !m_file.encoding.empty())
+        return;
+
+    // Generated bodies are compressed while they are sent, files only if their compressed variant can be cached
+    if (m_file.path.is_directory())
+        compressible = is_compressible("text/html");
+    else if (m_file.path.get_extension() == ".sh")
+        compressible = is_compressible(m_file.mime);
+    else if (m_file.path.is_regular()) {
+        off_t size = m_file.path.get_file_status().st_size;
+        compressible = size >= m_compression_min_size
+                && static_cast<size_t>(size) <= m_compression_cache->get_max_size() && is_compressible(m_file.mime);
+    }
+    if (!compressible)
+        return;
+
+    // Response depends on Accept-Encoding even if client does not accept gzip
+    m_file.varies = true;
+    if (get_quality(m_file.accept_encoding, "gzip") > 0) {
+        m_file.encoding = "gzip";
+        m_file.is_compressed = true;
+    }
+    return;
+}
+
+bool Request::is_compressible(const string &mime) const noexcept {
+    // Type ending with '*' matches every mime type starting with its prefix
+    for (const auto &type : m_compression_types) {
+        if (type == mime || (type.back() == '*'
+                && mime.compare(0, type.length() - 1, type, 0, type.length() - 1) == 0))
+            return true;
+    }
+    return false;
+}
+
+vector<string> Request::get_types(const string &types) noexcept {
+    vector<string> types_list;
+
+    for (size_t start = 0, end = 0; start < types.length(); start = end + 1) {
+        end = types.find(',', start);
+        if (end == string::npos)
+            end = types.length();
+        if (end > start)
+            types_list.push_back(types.substr(start, end - start));
+    }
+
+    return types_list;
+}
+
+string Request::get_cache_key(const Path &path) const noexcept {
+    if (!m_file.is_compressed)
+        return path.get_absolute();
+    return path.get_absolute() + '\0' + m_file.encoding;
+}
+
+bool Request::is_response_cacheable() const noexcept {
+    return m_response_cache->get_max_size() > 0 && m_method == HttpConstants::METHOD_GET && m_file.etag.empty()
+            && m_file.range.empty() && m_file.path.is_regular() && m_file.path.get_extension() != ".sh"
+            && m_file.path.get_file_status().st_size <= m_response_cache_max_file_size;
+}
+
+string Request::get_response_key() const noexcept {
+    return get_cache_key(m_file.path) + '\0' + (m_keep_alive ? "keep-alive" : "close");
+}
+
+bool Request::find_response(vector<Response::segment> &response) noexcept {
+    ContentCache::content cached;
+    size_t date_offset = Response::get_date_offset(HttpConstants::CODE_OK), date_end = 0;
+
+    if (!m_response_cache->find_file(get_response_key(), m_file.path.get_file_status(), cached))
+        return false;
+    date_end = cached.data->find("\r\n", date_offset);
+
+    // Client revalidates ETag of kept response later, so its cache entry has to stay as fresh as if it was sent now
+    if (!m_cache->add_file(get_cache_key(m_file.path), m_file.etag, m_file.path.get_file_status()))
+        m_logger->log_message(Logger::ERROR, m_file.path.get_absolute() + ": unable to add file to cache");
+
+    // Only date is not shared, all three parts are sent at once
+    m_code = HttpConstants::CODE_OK;
+    response.emplace_back(cached.data, 0, date_offset);
+    response.emplace_back(Clock::get_http_date());
+    response.emplace_back(cached.data, date_end, cached.data->length() - date_end);
+    record_response(*cached.data, response);
+
+    return true;
+}
+
+void Request::add_response(const vector<Response::segment> &response) noexcept {
+    size_t date_offset = Response::get_date_offset(HttpConstants::CODE_OK);
+
+    if (m_code != HttpConstants::CODE_OK)
+        return;
+
+    // Small file sent without reading it is read once, so it can be kept in response
+    auto data = make_shared<string>();
+    for (const auto &response_segment : response) {
+        if (response_segment.stream != nullptr || (response_segment.file != nullptr && response_segment.offset != 0))
+            return;
+        if (response_segment.file == nullptr) {
+            data->append(response_segment.get_data());
+            continue;
+        }
+        auto file_data = ContentCache::read_file(*response_segment.file, response_segment.length);
+        if (file_data == nullptr)
+            return;
+        data->append(*file_data);
+    }
+    if (data->compare(date_offset - 6, 6, "Date: ") != 0)
+        return;
+
+    m_response_cache->add_data(get_response_key(), data, m_file.path.get_file_status(), false);
+    return;
+}
+
+void Request::record_response(const string &head, const vector<Response::segment> &response) noexcept {
+    size_t bytes = 0;
+    auto now = chrono::steady_clock::now();
+
+    m_counters.record_time(Metrics::PHASE_PARSE, m_parsed - m_start);
+    m_counters.record_time(Metrics::PHASE_GENERATE, now - m_parsed);
+    m_counters.count_request(m_method, m_code);
+
+    for (const auto &segment : response) {
+        if (segment.file != nullptr || segment.shared_data != nullptr)
+            bytes += segment.length;
+        else if (segment.stream == nullptr)
+            bytes += segment.data.length();
+    }
+    m_logger->log_http(m_parser, m_ip, m_code, bytes,
+            chrono::duration_cast<chrono::microseconds>(now - m_start), head);
+
+    return;
+}
+
+shared_ptr<const string> Request::compress_file(const Path &path, shared_ptr<const string> data,
+        const shared_ptr<FileDescriptor> &file, const off_t &size, const bool &is_text_file) noexcept {
+    ContentCache::content cached;
+    string key = get_cache_key(path);
+
+    // File was already compressed
+    if (path.has_status() && m_compression_cache->find_file(key, path.get_file_status(), cached))
+        return cached.data;
+
+    // File which is not in file content cache is read only to be compressed
+    if (data == nullptr && file != nullptr)
+        data = ContentCache::read_file(*file, size);
+    if (data == nullptr)
+        return nullptr;
+
+    auto compressed = make_shared<string>();
+    try {
+        Compressor compressor(m_compression_level);
+        if (!compressor.compress(*data, Compressor::FLUSH_FINISH, *compressed))
+            return nullptr;
+    } catch (const runtime_error& e) {
+        return nullptr;
+    }
+
+    if (path.has_status())
+        m_compression_cache->add_data(key, compressed, path.get_file_status(), is_text_file);
+    return compressed;
+}
+
+bool Request::open_file(Path &path) noexcept {
+    bool exists = false, from_metadata = false, known = false;
+    struct stat status;
+    shared_ptr<FileDescriptor> file = nullptr;
+
+    // File status known from earlier request
+    from_metadata = known = m_metadata_cache->find_file(path.get_http(), status, exists);
+    if (from_metadata && !exists)
+        return false;
+
+    // Status of file is needed to check open file kept from earlier request, but reading it is cheaper than opening
+    if (!known && m_descriptor_cache->is_enabled())
+        known = (fstatat(m_root_fd.get(), ("." + path.get_http()).c_str(), &status, 0) == 0);
+    if (known && S_ISREG(status.st_mode))
+        file = m_descriptor_cache->find_file(path.get_absolute(), status);
+
+    // File found without opening it, it was opened beneath root directory when it was cached
+    if (file != nullptr || (from_metadata && (!S_ISREG(status.st_mode) || !m_descriptor_cache->is_enabled()))) {
+        path.set_status(status);
+        path.set_file(file);
+        if (!from_metadata)
+            m_metadata_cache->add_file(path.get_http(), *file);
+        return true;
+    }
+
+    if (!path.open_at(m_root_fd.get())) {
+        if (errno == ENOENT)
+            m_metadata_cache->add_missing(path.get_http());
+        return false;
+    }
+    if (!from_metadata)
+        m_metadata_cache->add_file(path.get_http(), *path.get_file());
+    m_descriptor_cache->add_file(path.get_absolute(), path.get_file(), path.get_file_status());
+
+    return true;
+}
+
 void Request::construct_body() noexcept {
     bool is_text_file = true;
-    unique_ptr<Generator> generator = nullptr;
+    off_t file_size = 0;
+    shared_ptr<Generator> generator = nullptr;
+    shared_ptr<FileDescriptor> file = nullptr;
+    shared_ptr<const string> file_data = nullptr, compressed_data = nullptr;
+    ContentCache::content cached;
     string error_message = m_file.path.get_absolute() + ": ";
 
     // Get generator
@@ -153,9 +513,43 @@ void Request::construct_body() noexcept {
         return;
     }
 
-    // Get response body
+    // Get response body, hot files are served from memory and other open files are sent without reading them
     try {
-        m_response->set_body(generator->get_body(is_text_file));
+        const Path &generator_path = generator->get_path();
+        bool is_cacheable = generator->is_cacheable() && generator_path.has_status();
+        if (is_cacheable && m_content_cache->find_file(generator_path.get_absolute(),
+                generator_path.get_file_status(), cached)) {
+            is_text_file = cached.is_text_file;
+            file_data = cached.data;
+        } else if ((file = generator->get_file(is_text_file, file_size)) != nullptr) {
+            if (is_cacheable)
+                file_data = m_content_cache->add_file(generator_path.get_absolute(), *file,
+                        generator_path.get_file_status(), is_text_file);
+        } else if (generator->is_streamed()) {
+            // Body of unknown length is generated (and compressed) while it is being sent, only if it is sent at all
+            if (m_file.is_compressed)
+                generator = make_shared<GzipGenerator>(generator, m_compression_level);
+            if (m_method == HttpConstants::METHOD_GET)
+                generator->open_stream();
+            m_response->set_body_stream(generator);
+        } else
+            throw runtime_error("unable to generate body");
+
+        // Compressed file replaces the original, if it cannot be compressed the original is sent
+        if (m_file.is_compressed && (file_data != nullptr || file != nullptr)) {
+            compressed_data = compress_file(generator_path, file_data, file, file_size, is_text_file);
+            if (compressed_data == nullptr) {
+                m_file.is_compressed = false;
+                m_file.encoding.clear();
+            }
+        }
+
+        if (compressed_data != nullptr)
+            m_response->set_body_data(compressed_data);
+        else if (file_data != nullptr)
+            m_response->set_body_data(file_data);
+        else if (file != nullptr)
+            m_response->set_body_file(file, file_size);
     } catch (const runtime_error& e) {
         error_message += e.what();
         m_logger->log_message(Logger::ERROR, error_message);
@@ -169,9 +563,16 @@ void Request::construct_body() noexcept {
 
     m_code = HttpConstants::CODE_OK;
 
+    // Only plain file contents can be sent in ranges
+    if (generator->is_cacheable() && !m_file.is_compressed) {
+        m_response->set_header("Accept-Ranges", "bytes");
+        if (m_method == HttpConstants::METHOD_GET && !m_file.range.empty())
+            set_ranges();
+    }
+
     // Add new file to cache
     if (m_method == HttpConstants::METHOD_GET) {
-        if (!m_cache->add_file(m_file.path.get_absolute(), m_file.etag)) {
+        if (!m_cache->add_file(get_cache_key(m_file.path), m_file.etag, m_file.path.get_file_status())) {
             error_message += "unable to add file to cache";
             m_logger->log_message(Logger::ERROR, error_message);
         }
@@ -180,82 +581,141 @@ void Request::construct_body() noexcept {
     return;
 }
 
-void Request::set_mime(const string &extension) noexcept {
-    auto mimes_itr = Server::mimes.find(extension);
-    if (mimes_itr == Server::mimes.end()) {
-        m_file.mime = "application/octet-stream";
+void Request::set_ranges() noexcept {
+    vector<Response::range> ranges;
+    off_t size = m_response->get_body_length();
+
+    // Client has different version of file, so it needs all of it (dates are never equal, we do not send them)
+    if (!m_file.if_range.empty() && (m_cache->get_time() == 0
+            || m_file.if_range != Cache::get_etag(m_file.path.get_absolute(), m_file.path.get_file_status())))
+        return;
+
+    if (!parse_ranges(m_file.range, size, ranges))
+        return;
+
+    if (ranges.empty()) {
+        m_response->set_header("Content-Range", "bytes */" + to_string(size));
+        m_code = HttpConstants::CODE_RANGE_NOT_SATISFIABLE;
         return;
     }
-    m_file.mime = mimes_itr->second;
+
+    m_response->set_ranges(ranges);
+    m_code = HttpConstants::CODE_PARTIAL_CONTENT;
     return;
 }
 
-bool Request::extract_header(const string &header, string &destination) noexcept {
-    // Find start position of header value (add 2 for ': ')
-    // Example -> header: "value"\r\n
-    auto pos_start = m_request_data.find(header);
-    if (pos_start == string::npos)
-        return false;
-    pos_start += 2 + header.length();
+bool Request::parse_ranges(const string &range, const off_t &size, vector<Response::range> &ranges) noexcept {
+    size_t count = 0;
+    static const size_t max_digits = 18;
 
-    // Find position of header value end
-    auto pos_end = m_request_data.find("\r\n", pos_start);
-    if (pos_end == string::npos)
+    // Other units are not known
+    if (range.length() < 6 || strncasecmp(range.c_str(), "bytes=", 6) != 0)
         return false;
-    pos_end -= pos_start;
 
-    destination = m_request_data.substr(pos_start, pos_end);
+    for (size_t start = 6, end = 0; start <= range.length(); start = end + 1) {
+        end = range.find(',', start);
+        if (end == string::npos)
+            end = range.length();
 
-    return true;
+        // Trim optional white space, empty list elements are allowed
+        size_t first_pos = range.find_first_not_of(" \t", start), last_pos = end;
+        while (last_pos > start && (range[last_pos - 1] == ' ' || range[last_pos - 1] == '\t'))
+            --last_pos;
+        if (first_pos == string::npos || first_pos >= last_pos)
+            continue;
+        if (++count > Request::max_ranges)
+            return false;
+
+        // Split range to first and last byte position, both have to be numbers if present
+        string spec = range.substr(first_pos, last_pos - first_pos);
+        size_t dash = spec.find('-');
+        if (dash == string::npos)
+            return false;
+        string first = spec.substr(0, dash), last = spec.substr(dash + 1);
+        if ((first.empty() && last.empty()) || first.length() > max_digits || last.length() > max_digits
+                || first.find_first_not_of("0123456789") != string::npos
+                || last.find_first_not_of("0123456789") != string::npos)
+            return false;
+
+        // Suffix range asks for last bytes of body
+        if (first.empty()) {
+            off_t suffix = stoll(last);
+            if (suffix > 0 && size > 0)
+                ranges.push_back({max(size - suffix, (off_t)0), size - 1});
+            continue;
+        }
+
+        off_t first_byte = stoll(first), last_byte = last.empty() ? size - 1 : stoll(last);
+        if (!last.empty() && last_byte < first_byte)
+            return false;
+        if (first_byte < size)
+            ranges.push_back({first_byte, min(last_byte, size - 1)});
+    }
+
+    return count > 0;
+}
+
+void Request::set_mime(const string &extension) noexcept {
+    auto mimes_itr = Server::mimes.find(extension);
+    if (mimes_itr == Server::mimes.end()) {
+        m_file.mime = "application/octet-stream";
+        return;
+    }
+    m_file.mime = mimes_itr->second;
+    return;
 }
 
-void Request::parse_status_line () noexcept {
-    // Line looks like "GET /index.html HTTP/1.1\r\n"
-    string word;
-    istringstream request_stream(m_request_data);
+void Request::set_method() noexcept {
+    string_view method = m_parser.get_method();
 
-    // Extract request method
-    request_stream >> word;
-    if (word == "GET")
+    if (method == "GET")
         m_method = HttpConstants::METHOD_GET;
-    else if (word == "HEAD")
+    else if (method == "HEAD")
         m_method = HttpConstants::METHOD_HEAD;
-    else if (word == "POST" || word == "PUT" || word == "DELETE" || word == "CONNECT"
-            || word == "OPTIONS" || word == "TRACE" || word == "PATCH")
+    else if (method == "POST" || method == "PUT" || method == "DELETE" || method == "CONNECT"
+            || method == "OPTIONS" || method == "TRACE" || method == "PATCH")
         m_method = HttpConstants::METHOD_UNKNOWN;
     else
         m_method = HttpConstants::METHOD_ERROR;
 
-    // Extract request path
-    if (request_stream.fail() || request_stream.eof())
-        return;
-    request_stream >> word;
-    m_file.path = word;
-
-    // Extract HTTP version
-    request_stream.clear();
-    if (request_stream.fail() || request_stream.eof())
-        return;
-    request_stream >> word;
-    m_version = word;
-
     return;
 }
 
-void Request::parse() noexcept {
-    parse_status_line();
-    decode_url(m_file.path.get_http());
+bool Request::parse(const string_view &request_data) noexcept {
+    string_view value;
+
+    if (!m_parser.parse(request_data))
+        return false;
+    set_method();
+    decode_url(m_parser.get_target());
     set_mime(m_file.path.get_extension());
-    extract_header("If-None-Match", m_file.etag);
-    return;
+    if (m_parser.find_header("If-None-Match", value))
+        m_file.etag.assign(value);
+    if (m_parser.find_header("Range", value))
+        m_file.range.assign(value);
+    if (m_parser.find_header("If-Range", value))
+        m_file.if_range.assign(value);
+    if (m_parser.find_header("Accept-Encoding", value))
+        m_file.accept_encoding.assign(value);
+
+    // Client asks to close connection
+    if (m_parser.find_header("Connection", value) && value.length() == 5
+            && strncasecmp(value.data(), "close", 5) == 0)
+        m_keep_alive = false;
+
+    // We do not read request bodies, so we would not know where next request starts
+    if (m_parser.find_header("Content-Length", value) || m_parser.find_header("Transfer-Encoding", value))
+        m_keep_alive = false;
+
+    return true;
 }
 
-void Request::decode_url(const string &url) noexcept {
+void Request::decode_url(const string_view &url) noexcept {
     // Adjusted code from https://www.rosettacode.org/wiki/URL_decoding#C
     string path_buffer;
-    unsigned int hex = 0, len = url.length();
-    char c = 0;
+    size_t len = url.length();
 
+    path_buffer.reserve(len);
     for (size_t i = 0; i < len; i++) {
         // Space
         if (url[i] == '+') {
@@ -264,13 +724,11 @@ void Request::decode_url(const string &url) noexcept {
         }
         // Decode % symbol
         if (url[i] == '%') {
-            if (!isxdigit(url[i + 1]) || !isxdigit(url[i + 2])) {
+            if (i + 2 >= len || !isxdigit(url[i + 1]) || !isxdigit(url[i + 2])) {
                 m_file.path = "";
                 return;
             } else {
-                sscanf(url.substr(i+1, 2).c_str(), "%x", &hex);
-                c = static_cast<char>(hex);
-                path_buffer += c;
+                path_buffer += static_cast<char>(hex_value(url[i + 1]) << 4 | hex_value(url[i + 2]));
                 i += 2;
                 continue;
             }
@@ -281,4 +739,10 @@ void Request::decode_url(const string &url) noexcept {
 
     m_file.path = path_buffer;
     return;
-}
\ No newline at end of file
+}
+
+int Request::hex_value(const char &c) noexcept {
+    if (isdigit(c))
+        return c - '0';
+    return tolower(c) - 'a' + 10;
+}
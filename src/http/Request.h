@@ -6,17 +6,26 @@
 #define EIRSERVER_REQUEST_H
 
 #include <string>
+#include <string_view>
 #include <arpa/inet.h>
 #include <memory>
 #include <map>
+#include <vector>
+#include <fcntl.h>
+#include <chrono>
 
 #include "../server/Config.h"
 #include "../server/Cache.h"
+#include "../server/ContentCache.h"
+#include "../server/MetadataCache.h"
+#include "../server/DescriptorCache.h"
+#include "../server/Metrics.h"
 #include "../loggers/Logger.h"
 #include "../generators/Generator.h"
 #include "../server/Path.h"
 #include "Response.h"
 #include "HttpConstants.h"
+#include "RequestParser.h"
 
 using namespace std;
 
@@ -27,37 +36,81 @@ class Request {
     public:
         /**
          * Sets pointer to loaded configuration (m_config), pointer to active cache (m_cache), pointer to active
-         * logger (m_logger), creates pointer to server HTTP response (m_response) and setups m_file with
-         * path to root_dir from configuration.
+         * file content cache (m_content_cache), pointer to active file metadata cache (m_metadata_cache), pointer
+         * to active open file cache (m_descriptor_cache), pointer to active compressed file cache
+         * (m_compression_cache), pointer to active response cache (m_response_cache), pointer to active logger
+         * (m_logger), pointer to server metrics (m_metrics) and counters of calling worker (m_counters), creates
+         * pointer to server HTTP response (m_response), setups m_file with path to root_dir from configuration,
+         * opens root_dir (m_root_fd) and reads compression, response cache and metrics settings.
          * @param[in] config Pointer to server configuration.
          * @param[in] cache Pointer to server cache.
+         * @param[in] content_cache Pointer to server file content cache.
+         * @param[in] metadata_cache Pointer to server file metadata cache.
+         * @param[in] descriptor_cache Pointer to server open file cache.
+         * @param[in] compression_cache Pointer to server compressed file cache.
+         * @param[in] response_cache Pointer to server response cache.
          * @param[in] logger Pointer to server logger.
+         * @param[in] metrics Pointer to server metrics.
+         * @param[in] counters Metrics counters of worker calling this handler.
          */
-        Request(shared_ptr<Config> config, shared_ptr<Cache> cache, shared_ptr<Logger> logger):
-            m_response(make_unique<Response>()), m_config(config), m_cache(cache), m_logger(logger),
-            m_file(m_config->find_setting_val("root_dir")) {}
+        Request(shared_ptr<Config> config, shared_ptr<Cache> cache, shared_ptr<ContentCache> content_cache,
+                shared_ptr<MetadataCache> metadata_cache, shared_ptr<DescriptorCache> descriptor_cache,
+                shared_ptr<ContentCache> compression_cache, shared_ptr<ContentCache> response_cache,
+                shared_ptr<Logger> logger, shared_ptr<Metrics> metrics, Metrics::counters &counters):
+            m_response(make_unique<Response>()), m_config(config), m_cache(cache), m_content_cache(content_cache),
+            m_metadata_cache(metadata_cache), m_descriptor_cache(descriptor_cache),
+            m_compression_cache(compression_cache), m_response_cache(response_cache), m_logger(logger),
+            m_metrics(metrics), m_counters(counters),
+            m_root_fd(open(m_config->find_setting_val("root_dir").c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC)),
+            m_method(HttpConstants::METHOD_ERROR), m_keep_alive(false), m_file(m_config->find_setting_val("root_dir")),
+            m_compression_level(stoi(m_config->find_setting_val("compression_level"))),
+            m_compression_min_size(stoll(m_config->find_setting_val("compression_min_size"))),
+            m_compression_types(get_types(m_config->find_setting_val("compression_types"))),
+            m_response_cache_max_file_size(stoll(m_config->find_setting_val("response_cache_max_file_size"))),
+            m_metrics_address(m_config->find_setting_val("metrics_address")) {}
         /**
-         * Sets m_ip, m_request_data and parses HTTP request. \n
+         * Sets m_ip and parses HTTP request. \n
          * For bad request sets response to HttpConstants::CODE_BAD_REQUEST and returns. \n
          * For invalid HTTP protocol version sets response to HttpConstants::CODE_HTTP_VERSION and returns. \n
          * For unknown HTTP method sets response to HttpConstants::CODE_NOT_IMPLEMENTED and returns. \n
          * If requested path is equal to server shutdown path calls raise(SIGTERM). \n
-         * Checks if file exists and for nonexistent file sets response to HttpConstants::CODE_NOT_FOUND and returns. \n
+         * If requested path is equal to \ref MetricsAddress "metrics_address" responds with Metrics::render(). \n
+         * Finds file by open_file() and for nonexistent file sets response to HttpConstants::CODE_NOT_FOUND
+         * and returns. Status of found file is then used by all following checks. \n
+         * Chooses precompressed variant of file by choose_encoding() or compression of body by
+         * choose_compression(). \n
+         * Response to small file is sent from response cache if it is there, see find_response(). \n
          * For valid request checks cache and for not modified file sets response to
          * HttpConstants::CODE_NOT_MODIFIED and returns. \n
          * Finally for modified or not cached file constructs response body and returns.\n
-         * @param[in] request_data Complete data of client request.
+         * @param[in] request_data Complete data of client request, must stay untouched until reset() is called.
          * @param[in] ip IP of client.
+         * @param[in] keep_alive Whether connection may stay open after this request.
          * @see Response
          * @see HttpConstants
          * @see parse()
          * @see construct_body()
          * @see get_response()
-         * @return String containing full HTTP response.
+         * @return Vector of segments containing full HTTP response.
+         */
+        vector<Response::segment> handle(const string_view &request_data, const char ip[INET_ADDRSTRLEN], const bool &keep_alive) noexcept;
+        /**
+         * Sets m_ip and constructs error response with given code to request which could not be received
+         * completely. Connection is always closed after such response.
+         * @param[in] code HTTP response code.
+         * @param[in] ip IP of client.
+         * @return Vector of segments containing full HTTP response.
+         */
+        vector<Response::segment> handle_error(const string &code, const char ip[INET_ADDRSTRLEN]) noexcept;
+        /**
+         * Checks if connection should stay open after response to handled request (m_keep_alive).
+         * @return true if connection should stay open, false otherwise.
          */
-        string handle(const string &request_data, const char ip[INET_ADDRSTRLEN]) noexcept;
+        bool is_keep_alive() const noexcept;
         /**
-         * Resets all members to their default state excluding m_config, m_cache and m_logger.
+         * Resets all members to their default state excluding m_config, m_cache, m_content_cache, m_metadata_cache,
+         * m_descriptor_cache, m_compression_cache, m_response_cache, m_logger, m_metrics, m_counters, compression,
+         * response cache and metrics settings.
          */
         void reset() noexcept;
     private:
@@ -67,40 +120,98 @@ class Request {
         shared_ptr<Config> m_config;
         /** Member holding pointer to server cache. */
         shared_ptr<Cache> m_cache;
+        /** Member holding pointer to server file content cache. */
+        shared_ptr<ContentCache> m_content_cache;
+        /** Member holding pointer to server file metadata cache. */
+        shared_ptr<MetadataCache> m_metadata_cache;
+        /** Member holding pointer to server open file cache. */
+        shared_ptr<DescriptorCache> m_descriptor_cache;
+        /** Member holding pointer to server cache of compressed files. */
+        shared_ptr<ContentCache> m_compression_cache;
+        /** Member holding pointer to server cache of complete responses. */
+        shared_ptr<ContentCache> m_response_cache;
         /** Member holding pointer to server logger. */
         shared_ptr<Logger> m_logger;
-        /** Member holding complete data of client HTTP request. */
-        string m_request_data;
+        /** Member holding pointer to server metrics. */
+        shared_ptr<Metrics> m_metrics;
+        /** Member holding metrics counters of worker using this handler. */
+        Metrics::counters &m_counters;
+        /** Member holding open root directory, relative to which are all requested files opened. */
+        FileDescriptor m_root_fd;
+        /** Member holding parsed client HTTP request. */
+        RequestParser m_parser;
         /** Member holding client IP address. */
         string m_ip;
+        /** Member holding time at which handling of current request started. */
+        chrono::steady_clock::time_point m_start;
+        /** Member holding time at which current request was parsed. */
+        chrono::steady_clock::time_point m_parsed;
         /** Member holding requested HTTP method. */
         HttpConstants::http_methods m_method;
-        /** Member holding requested HTTP protocol version */
-        string m_version;
+        /** Member holding whether connection should stay open after response. */
+        bool m_keep_alive;
         /** Struct holding information about requested file. */
         struct file {
             /**
              * Sets root_dir of requested file.
              * @param[in] root_dir Path to server root directory.
              */
-            file(const string &root_dir): path(root_dir) {}
+            file(const string &root_dir): path(root_dir), varies(false), is_compressed(false), is_volatile(false) {}
             /** Member holding requested path. */
             Path path;
             /** Member holding mime type of requested file. */
             string mime;
             /** Member holding etag value of requested file. */
             string etag;
+            /** Member holding value of Range header. */
+            string range;
+            /** Member holding value of If-Range header. */
+            string if_range;
+            /** Member holding value of Accept-Encoding header. */
+            string accept_encoding;
+            /** Member holding content coding of sent file variant, empty if original file is sent. */
+            string encoding;
+            /** Member holding whether response depends on Accept-Encoding header. */
+            bool varies;
+            /** Member holding whether body is compressed by server with m_file.encoding. */
+            bool is_compressed;
+            /** Member holding whether body is generated anew for every request and must not be stored (metrics). */
+            bool is_volatile;
         };
         /** Member holding information about requested file. */
         struct file m_file;
+        /** Member holding compression level of compressed responses (0 disables compression). */
+        int m_compression_level;
+        /** Member holding minimum size of compressed file. */
+        off_t m_compression_min_size;
+        /** Member holding mime types of compressed responses, type may end with '*'. */
+        vector<string> m_compression_types;
+        /** Member holding maximum size of file whose response is kept in m_response_cache. */
+        off_t m_response_cache_max_file_size;
+        /** Member holding path at which metrics are served (empty if they are disabled). */
+        string m_metrics_address;
         /** Member holding HTTP response code. */
         string m_code;
+        /** Static member holding maximum number of ranges client may ask for in one request. */
+        static const size_t max_ranges = 16;
         /**
-         * Sets response method, code, all headers and calls construct() on m_response.
+         * Struct holding content coding of precompressed file variant.
+         */
+        struct encoding {
+            /** Member holding name of content coding. */
+            const char *name;
+            /** Member holding extension appended to original file name. */
+            const char *extension;
+        };
+        /** Static member holding known content codings of precompressed files, most preferred first. */
+        static const struct encoding encodings[2];
+        /**
+         * Sets response method, code, all headers and calls construct() on m_response. Error responses
+         * close the connection.
          * @see Response
-         * @return String containing full HTTP response.
+         * @return Vector of segments containing full HTTP response.
          */
-        string get_response() noexcept;
+        vector<Response::segment> get_response() noexcept;
         /**
          * Chooses which response body \ref Generator "generator" to use. ScriptGenerator for files with extension '.sh'.
          * RegularGenerator for regular files and directories containing file named 'index.html'.
@@ -108,51 +219,171 @@ class Request {
          * @return Pointer to response body generator. Nullptr if no generator is chosen (should not happen).
          */
         unique_ptr<Generator> get_generator();
+        /**
+         * Replaces requested regular file with its precompressed variant found next to it (for example 'app.js.br'
+         * or 'app.js.gz'), if \ref Precompressed "precompressed" is on and client accepts its content coding.
+         * Codings with higher quality in Accept-Encoding are preferred, mime is still derived from original
+         * extension. Variant is then cached and sent like any other file, so it has its own ETag. If any variant
+         * exists, response varies by Accept-Encoding even if original file is sent.
+         * @see get_quality()
+         */
+        void choose_encoding() noexcept;
+        /**
+         * Gets quality with which client accepts content coding according to value of Accept-Encoding header.
+         * Coding not listed in header is accepted with quality of '*', if it is present.
+         * @param[in] accept_encoding Value of Accept-Encoding header.
+         * @param[in] coding Name of content coding.
+         * @return Quality between 0 (not acceptable) and 1.
+         */
+        static double get_quality(const string &accept_encoding, const string &coding) noexcept;
+        /**
+         * Chooses if response body is compressed with gzip while it is sent, if no precompressed variant of file
+         * was chosen and client accepts gzip. Directory listings and script outputs of compressible mime type are
+         * compressed while they are generated. Regular files of compressible mime type are compressed if they are
+         * at least \ref CompressionMinSize "compression_min_size" bytes large and fit to m_compression_cache, so
+         * every file is compressed only once.
+         * @see \ref CompressionTypes "compression_types"
+         */
+        void choose_compression() noexcept;
+        /**
+         * Checks if responses of mime type should be compressed.
+         * @param[in] mime Mime type of response.
+         * @return true if mime type is listed in m_compression_types, false otherwise.
+         */
+        bool is_compressible(const string &mime) const noexcept;
+        /**
+         * Splits comma separated list of mime types.
+         * @param[in] types List of mime types.
+         * @return Vector of mime types.
+         */
+        static vector<string> get_types(const string &types) noexcept;
+        /**
+         * Gets key of sent variant of file in Cache and m_compression_cache. Key of variant compressed by server
+         * is absolute path of file followed by null character and content coding, so it cannot be path of any
+         * other file.
+         * @param[in] path %Path of file.
+         * @return String containing key of file.
+         */
+        string get_cache_key(const Path &path) const noexcept;
+        /**
+         * Checks if response to current request may be served from m_response_cache and added to it. Only
+         * responses to GET requests of regular files not larger than m_response_cache_max_file_size without
+         * If-None-Match and Range headers are kept.
+         * @return true if response may be kept, false otherwise.
+         */
+        bool is_response_cacheable() const noexcept;
+        /**
+         * Gets key of response to current request in m_response_cache. Response depends on sent variant of file
+         * and on whether connection stays open.
+         * @return String containing key of response.
+         */
+        string get_response_key() const noexcept;
+        /**
+         * Finds complete response to current request in m_response_cache. Response is sent without copying it,
+         * only its Date header is replaced by current date. ETag of file is refreshed in m_cache as if response
+         * was constructed.
+         * @param[out] response Segments of found response.
+         * @return true if valid response was found, false otherwise.
+         */
+        bool find_response(vector<Response::segment> &response) noexcept;
+        /**
+         * Serializes response held in memory and tries to add it to m_response_cache.
+         * @param[in] response Segments of constructed response.
+         */
+        void add_response(const vector<Response::segment> &response) noexcept;
+        /**
+         * Records time spent parsing and generating response of current request and counts its method and response
+         * code in m_counters. Then logs fields of request with its response code, size of response and time spent
+         * handling it.
+         * @param[in] head Data starting with status line and headers of response, read only in verbose mode.
+         * @param[in] response Segments of response, streamed body is not counted in its size.
+         */
+        void record_response(const string &head, const vector<Response::segment> &response) noexcept;
+        /**
+         * Gets compressed data of file from m_compression_cache, or compresses file data and tries to add them
+         * to m_compression_cache.
+         * @param[in] path %Path of file.
+         * @param[in] data Data of file if they are in memory, nullptr otherwise.
+         * @param[in] file Open file read if data are not in memory.
+         * @param[in] size Size of file.
+         * @param[in] is_text_file Whether file looks like text file.
+         * @return Pointer to compressed data, nullptr if file cannot be read or compressed.
+         */
+        shared_ptr<const string> compress_file(const Path &path, shared_ptr<const string> data,
+                const shared_ptr<FileDescriptor> &file, const off_t &size, const bool &is_text_file) noexcept;
+        /**
+         * Finds file in path. Status of known file is taken from m_metadata_cache without any syscall. Regular file
+         * kept open in m_descriptor_cache is used if path still leads to it. Otherwise file is opened relative to
+         * m_root_fd and added to both caches.
+         * @param[in,out] path %Path of requested file, its status is set if file exists.
+         * @return true if file exists, false otherwise.
+         * @see Path::open_at()
+         */
+        bool open_file(Path &path) noexcept;
         /**
          * Gets pointer to response body \ref Generator "generator". If no \ref Generator "generator" is set
          * sets response to HttpConstants::CODE_INTERNAL_ERROR. Tries to set response body using
-         * \ref Generator "generator". For text file without extension sets mime to 'text/plain' and tries to
-         * add file to server cache.
+         * \ref Generator "generator". Cacheable files are served from ContentCache, other files are preferably
+         * sent from open file without copying them to memory. Directory listings and script outputs are streamed
+         * while they are generated. Body is compressed if choose_compression() chose so, compressed files are
+         * kept in m_compression_cache. For text file without extension sets mime to 'text/plain' and tries to add
+         * file to server cache.
          * @throw runtime_error If it is unable to check file or get its contents.
          * @see Generator
          * @see Cache
+         * @see ContentCache
          * @see get_generator()
          */
         void construct_body() noexcept;
+        /**
+         * Chooses which ranges of constructed body are sent. Range header is ignored if it is invalid, asks for
+         * more than max_ranges ranges or If-Range does not match current ETag of file. If no range is
+         * satisfiable sets response to HttpConstants::CODE_RANGE_NOT_SATISFIABLE, otherwise sets response to
+         * HttpConstants::CODE_PARTIAL_CONTENT.
+         * @see parse_ranges()
+         */
+        void set_ranges() noexcept;
+        /**
+         * Parses value of Range header in bytes unit (for example 'bytes=0-99,200-,-50').
+         * @param[in] range Value of Range header.
+         * @param[in] size Size of whole body.
+         * @param[out] ranges Satisfiable ranges in order they were requested.
+         * @return true if header is valid, false otherwise.
+         */
+        static bool parse_ranges(const string &range, const off_t &size, vector<Response::range> &ranges) noexcept;
         /**
          * Tries to guess mime type of requested file based on its extension and store it in m_file.mime.
          * @param extension Extension of requested file.
          */
         void set_mime(const string &extension) noexcept;
         /**
-         * Tries to find given header in m_request_data and sets its value to destination.
-         * @param[in] header HTTP request header we search for
-         * @param[out] destination Where should the header value be stored
-         * @return true if header found and value extracted, false otherwise
+         * Sets m_method from method parsed in m_parser.
          */
-        bool extract_header(const string &header, string &destination) noexcept;
+        void set_method() noexcept;
         /**
-         * Extracts request method to m_method, path to m_file.path and HTTP version to m_version from
-         * first line of request.
-         * @note Because first line of request looks like "METHOD /path/to/resource HTTP_VERSION",
-         * this function extracts all of them.
-         */
-        void parse_status_line () noexcept;
-        /**
-         * Sets m_method, m_file.path and m_version. Decodes requested URL to m_file.path
-         * Sets m_file.mime and m_file.etag.
-         * @see parse_status_line()
+         * Parses request data by m_parser and sets m_method. Decodes requested URL to m_file.path.
+         * Sets m_file.mime and m_file.etag. Clears m_keep_alive if client asks to close connection or request
+         * has body we would not know how to skip.
+         * @param[in] request_data Complete data of client request.
+         * @return true if request is well-formed, false otherwise.
+         * @see RequestParser
+         * @see set_method()
          * @see decode_url()
          * @see set_mime()
-         * @see extract_header()
          */
-        void parse() noexcept;
+        bool parse(const string_view &request_data) noexcept;
         /**
          * Decodes requested URL in percent encoding and stores its decoded value in m_file.path.
          * @param[in] url URL to be decoded.
          * @note Adjusted code from https://www.rosettacode.org/wiki/URL_decoding#C
          */
-        void decode_url(const string &url) noexcept;
+        void decode_url(const string_view &url) noexcept;
+        /**
+         * Converts hexadecimal digit to its value.
+         * @param[in] c Hexadecimal digit.
+         * @return Int representing value of digit.
+         */
+        static int hex_value(const char &c) noexcept;
 };
 
 #endif //EIRSERVER_REQUEST_H
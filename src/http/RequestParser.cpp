@@ -0,0 +1,127 @@
+//
+// Created by satopja2 on 17.10.26.
+//
+
+#include <strings.h>
+
+#include "RequestParser.h"
+#include "Scanner.h"
+
+bool RequestParser::parse(const string_view &data) noexcept {
+    size_t pos_start = 0, pos_end = 0;
+
+    reset();
+
+    // Request line looks like "GET /index.html HTTP/1.1\r\n"
+    if ((pos_end = find_line_end(data, 0)) == string_view::npos)
+        return false;
+    m_request_line = data.substr(0, pos_end);
+    if (!parse_request_line())
+        return false;
+
+    // Every header is on its own line, head ends with empty line
+    for (;;) {
+        pos_start = pos_end + 2;
+        if ((pos_end = parse_header(data, pos_start)) == string_view::npos)
+            return false;
+        if (pos_end == pos_start)
+            return true;
+    }
+}
+
+void RequestParser::reset() noexcept {
+    m_request_line = {};
+    m_method = {};
+    m_target = {};
+    m_version = {};
+    m_headers.clear();
+    return;
+}
+
+bool RequestParser::find_header(const string_view &name, string_view &value) const noexcept {
+    for (const auto &request_header : m_headers) {
+        if (request_header.name.length() == name.length()
+                && strncasecmp(request_header.name.data(), name.data(), name.length()) == 0) {
+            value = request_header.value;
+            return true;
+        }
+    }
+    return false;
+}
+
+string_view RequestParser::get_request_line() const noexcept {
+    return m_request_line;
+}
+
+string_view RequestParser::get_method() const noexcept {
+    return m_method;
+}
+
+string_view RequestParser::get_target() const noexcept {
+    return m_target;
+}
+
+string_view RequestParser::get_version() const noexcept {
+    return m_version;
+}
+
+const vector<RequestParser::header>& RequestParser::get_headers() const noexcept {
+    return m_headers;
+}
+
+bool RequestParser::parse_request_line() noexcept {
+    string_view *words[] = {&m_method, &m_target, &m_version};
+    size_t pos_start = 0, pos_end = 0, length = m_request_line.length();
+
+    for (auto word : words) {
+        // Words are separated by single spaces, but be tolerant to more of them
+        while (pos_start < length && m_request_line[pos_start] == ' ')
+            pos_start++;
+        pos_end = Scanner::find(m_request_line, pos_start, ' ', ' ');
+        if (pos_end == string_view::npos)
+            pos_end = length;
+        if (pos_end == pos_start)
+            return false;
+        *word = m_request_line.substr(pos_start, pos_end - pos_start);
+        pos_start = pos_end;
+    }
+
+    // Nothing but spaces may follow version
+    return m_request_line.find_first_not_of(' ', pos_start) == string_view::npos;
+}
+
+size_t RequestParser::parse_header(const string_view &data, const size_t &pos) noexcept {
+    // Header line looks like "Name: value\r\n", whitespace around value is not part of it
+    size_t pos_colon = Scanner::find(data, pos, ':', '\r'), pos_end = 0;
+    if (pos_colon == string_view::npos)
+        return string_view::npos;
+
+    // Empty line ends request head
+    if (data[pos_colon] == '\r')
+        return (pos_colon == pos && data.compare(pos, 2, "\r\n") == 0) ? pos : string_view::npos;
+
+    // No whitespace is allowed between name and colon
+    string_view name = data.substr(pos, pos_colon - pos);
+    if (name.empty() || name.find_first_of(" \t") != string_view::npos)
+        return string_view::npos;
+
+    if ((pos_end = find_line_end(data, pos_colon + 1)) == string_view::npos)
+        return string_view::npos;
+    string_view value = data.substr(pos_colon + 1, pos_end - pos_colon - 1);
+    size_t pos_start = value.find_first_not_of(" \t");
+    if (pos_start == string_view::npos)
+        value = {};
+    else
+        value = value.substr(pos_start, value.find_last_not_of(" \t") - pos_start + 1);
+
+    m_headers.push_back({name, value});
+    return pos_end;
+}
+
+size_t RequestParser::find_line_end(const string_view &data, const size_t &pos) noexcept {
+    // Bare '\r' is not allowed anywhere in request head
+    size_t pos_end = Scanner::find(data, pos, '\r', '\r');
+    if (pos_end == string_view::npos || data.compare(pos_end, 2, "\r\n") != 0)
+        return string_view::npos;
+    return pos_end;
+}
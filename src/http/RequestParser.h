@@ -0,0 +1,106 @@
+//
+// Created by satopja2 on 17.10.26.
+//
+
+#ifndef EIRSERVER_REQUEST_PARSER_H
+#define EIRSERVER_REQUEST_PARSER_H
+
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Class parsing HTTP request head in a single pass without copying it. Token boundaries are located by Scanner.
+ * @note All parsed parts are string_view slices into request data given to parse(), so they are valid only
+ * as long as the data stay untouched (until the request is consumed from connection buffer).
+ */
+class RequestParser {
+    public:
+        /**
+         * Struct holding one parsed request header.
+         */
+        struct header {
+            /** Member holding header name as sent by client. */
+            string_view name;
+            /** Member holding header value without surrounding whitespace. */
+            string_view value;
+        };
+        /**
+         * Parses request line (method, target and version) and all headers of complete request head.
+         * @param[in] data Complete request head ending with empty line.
+         * @return true if request head is well-formed, false otherwise.
+         * @note Parts parsed before malformed line stay available, so invalid request can still be logged.
+         */
+        bool parse(const string_view &data) noexcept;
+        /**
+         * Resets all parsed parts. Capacity of m_headers is kept, so parsing next request does not allocate.
+         */
+        void reset() noexcept;
+        /**
+         * Finds value of header, header names are compared case-insensitively.
+         * @param[in] name Name of header we search for.
+         * @param[out] value Where should the header value be stored.
+         * @return true if header was found, false otherwise.
+         */
+        bool find_header(const string_view &name, string_view &value) const noexcept;
+        /**
+         * Gets request line without line ending (example: "GET /favicon.ico HTTP/1.1").
+         * @return String view of request line.
+         */
+        string_view get_request_line() const noexcept;
+        /**
+         * Gets requested method (m_method).
+         * @return String view of method.
+         */
+        string_view get_method() const noexcept;
+        /**
+         * Gets requested target (m_target).
+         * @return String view of target.
+         */
+        string_view get_target() const noexcept;
+        /**
+         * Gets requested HTTP protocol version (m_version).
+         * @return String view of version.
+         */
+        string_view get_version() const noexcept;
+        /**
+         * Gets all parsed headers in order as they were received (m_headers).
+         * @return Reference to vector of headers.
+         */
+        const vector<header>& get_headers() const noexcept;
+    private:
+        /** Member holding request line. */
+        string_view m_request_line;
+        /** Member holding requested method. */
+        string_view m_method;
+        /** Member holding requested target. */
+        string_view m_target;
+        /** Member holding requested HTTP protocol version. */
+        string_view m_version;
+        /** Member holding all parsed headers. */
+        vector<header> m_headers;
+        /**
+         * Splits request line to m_method, m_target and m_version.
+         * @return true if request line consists of exactly three words, false otherwise.
+         */
+        bool parse_request_line() noexcept;
+        /**
+         * Splits header line starting at pos to name and value and appends it to m_headers. Colon and line
+         * ending are located by Scanner in one pass.
+         * @param[in] data Complete request head.
+         * @param[in] pos Position where header line starts.
+         * @return Position of header line ending, pos if line is empty (end of head) or string_view::npos
+         * if header line is malformed.
+         */
+        size_t parse_header(const string_view &data, const size_t &pos) noexcept;
+        /**
+         * Finds end of line ("\r\n") starting at pos using Scanner.
+         * @param[in] data Complete request head.
+         * @param[in] pos Position where line starts.
+         * @return Position of line ending or string_view::npos if line does not end with "\r\n".
+         */
+        static size_t find_line_end(const string_view &data, const size_t &pos) noexcept;
+};
+
+#endif //EIRSERVER_REQUEST_PARSER_H
@@ -3,8 +3,11 @@
 //
 
 #include <ctime>
+#include <atomic>
+#include <cstdio>
 
 #include "Response.h"
+#include "../server/Clock.h"
 
 void Response::set_header(const string &header, const string &value) noexcept {
     m_headers.insert_or_assign(header, value);
@@ -26,29 +29,119 @@ void Response::set_body(const string &data) noexcept {
     return;
 }
 
-string Response::construct() noexcept {
-    string response;
+void Response::set_body_file(shared_ptr<FileDescriptor> file, const off_t &length) noexcept {
+    m_body_file = file;
+    m_body_file_length = length;
+    return;
+}
+
+void Response::set_body_data(shared_ptr<const string> data) noexcept {
+    m_body_data = move(data);
+    return;
+}
+
+void Response::set_body_stream(shared_ptr<Generator> stream) noexcept {
+    m_body_stream = move(stream);
+    return;
+}
+
+off_t Response::get_body_length() const noexcept {
+    if (m_body_file != nullptr)
+        return m_body_file_length;
+    if (m_body_data != nullptr)
+        return m_body_data->length();
+    return m_body.length();
+}
+
+void Response::set_ranges(const vector<range> &ranges) noexcept {
+    m_ranges = ranges;
+    return;
+}
 
-    get_date();
+vector<Response::segment> Response::construct() noexcept {
+    string response, boundary, part_type;
+    vector<segment> segments;
+    vector<string> part_headers;
+    off_t body_length = get_body_length(), ranges_length = 0;
+    bool is_partial = (m_code == HttpConstants::CODE_PARTIAL_CONTENT && !m_ranges.empty());
+    bool has_body = (m_method != HttpConstants::METHOD_HEAD && (m_code == HttpConstants::CODE_OK || is_partial));
+
+    // Single range is sent as it is, more ranges are sent as parts with their own headers
+    if (is_partial && m_ranges.size() == 1)
+        set_header("Content-Range", "bytes " + to_string(m_ranges.front().first) + "-"
+                + to_string(m_ranges.front().last) + "/" + to_string(body_length));
+    if (is_partial && m_ranges.size() > 1) {
+        boundary = get_boundary();
+        auto type_itr = m_headers.find("Content-Type");
+        if (type_itr != m_headers.end())
+            part_type = "Content-Type: " + type_itr->second + "\r\n";
+        set_header("Content-Type", "multipart/byteranges; boundary=" + boundary);
+        for (const auto &body_range : m_ranges) {
+            part_headers.push_back("\r\n--" + boundary + "\r\n" + part_type + "Content-Range: bytes "
+                    + to_string(body_range.first) + "-" + to_string(body_range.last) + "/"
+                    + to_string(body_length) + "\r\n\r\n");
+            ranges_length += part_headers.back().length();
+        }
+        part_headers.push_back("\r\n--" + boundary + "--\r\n");
+        ranges_length += part_headers.back().length();
+    }
+    for (const auto &body_range : m_ranges)
+        ranges_length += body_range.last - body_range.first + 1;
 
     response = "HTTP/1.1 " + m_code + "\r\n";
     response += "Server: Eirserver\r\n";
-    response += "Date: " + get_date() + "\r\n";
+    response += "Date: " + Clock::get_http_date() + "\r\n";
 
     // Append headers
     for (auto const& header : m_headers)
         response += header.first + ": " + header.second + "\r\n";
 
-    if (!m_body.empty())
+    // Content length is needed for client to find end of response on persistent connection
+    if (is_partial)
+        response += "Content-Length: " + to_string(ranges_length) + "\r\n";
+    else if (m_code == HttpConstants::CODE_OK && m_body_stream != nullptr)
+        response += "Transfer-Encoding: chunked\r\n";
+    else if (m_code == HttpConstants::CODE_OK && m_body_file != nullptr)
+        response += "Content-Length: " + to_string(m_body_file_length) + "\r\n";
+    else if (m_code == HttpConstants::CODE_OK && m_body_data != nullptr)
+        response += "Content-Length: " + to_string(m_body_data->length()) + "\r\n";
+    else if (m_code == HttpConstants::CODE_OK)
         response += "Content-Length: " + to_string(m_body.length()) + "\r\n";
+    else if (m_code != HttpConstants::CODE_NOT_MODIFIED)
+        response += "Content-Length: 0\r\n";
 
     response += "\r\n";
-
-    // Append body
-    if (m_method != HttpConstants::METHOD_HEAD && m_code == HttpConstants::CODE_OK)
-        response += m_body;
-
-    return response;
+    segments.emplace_back(move(response));
+
+    // Body in memory is sent together with headers, but it is not copied after them
+    if (has_body && !is_partial && !m_body.empty())
+        segments.emplace_back(move(m_body));
+
+    // Ranges of body are sent without copying shared or file body
+    if (has_body && is_partial) {
+        for (size_t i = 0; i < m_ranges.size(); ++i) {
+            if (!part_headers.empty())
+                append_data(segments, part_headers[i]);
+            append_body(segments, m_ranges[i]);
+        }
+        if (!part_headers.empty())
+            append_data(segments, part_headers.back());
+        return segments;
+    }
+
+    // Shared body is sent separately, without copying it
+    if (has_body && m_body_data != nullptr && !m_body_data->empty())
+        segments.emplace_back(m_body_data);
+
+    // Streamed body is generated while it is being sent
+    if (has_body && m_body_stream != nullptr)
+        segments.emplace_back(m_body_stream);
+
+    // File body is sent separately, without reading it to memory
+    if (has_body && m_body_file != nullptr && m_body_file_length > 0)
+        segments.emplace_back(m_body_file, 0, m_body_file_length);
+
+    return segments;
 }
 
 void Response::reset() noexcept {
@@ -56,17 +149,48 @@ void Response::reset() noexcept {
     m_method = HttpConstants::METHOD_UNKNOWN;
     m_code.clear();
     m_body.clear();
+    m_body_file = nullptr;
+    m_body_file_length = 0;
+    m_body_data = nullptr;
+    m_body_stream = nullptr;
+    m_ranges.clear();
     return;
 }
 
-string Response::get_date() noexcept {
-    string date;
-    char date_c_str[30];
-    time_t time_obj = time(nullptr);
+void Response::append_data(vector<segment> &segments, const string &data) noexcept {
+    if (!segments.empty() && segments.back().file == nullptr && segments.back().shared_data == nullptr
+            && segments.back().stream == nullptr)
+        segments.back().data += data;
+    else
+        segments.emplace_back(data);
+    return;
+}
 
-    // Get current date and time
-    strftime(date_c_str, sizeof(date_c_str), "%a, %d %b %Y %T GMT", gmtime(&time_obj));
-    date.append(date_c_str);
+void Response::append_body(vector<segment> &segments, const struct range &body_range) const noexcept {
+    off_t length = body_range.last - body_range.first + 1;
 
-    return date;
-}
\ No newline at end of file
+    if (m_body_file != nullptr)
+        segments.emplace_back(m_body_file, body_range.first, length);
+    else if (m_body_data != nullptr)
+        segments.emplace_back(m_body_data, body_range.first, length);
+    else
+        append_data(segments, m_body.substr(body_range.first, length));
+
+    return;
+}
+
+string Response::get_boundary() noexcept {
+    static atomic<unsigned long> counter(0);
+    char boundary[33];
+
+    // Mix time with counter, so boundaries differ between responses and server runs
+    unsigned long long mixed = (static_cast<unsigned long long>(time(nullptr)) << 20) ^ counter.fetch_add(1);
+    mixed *= 0x9e3779b97f4a7c15ULL;
+    snprintf(boundary, sizeof(boundary), "eirserver%016llx", mixed);
+
+    return boundary;
+}
+
+size_t Response::get_date_offset(const string &code) noexcept {
+    return string("HTTP/1.1 ").length() + code.length() + string("\r\nServer: Eirserver\r\nDate: ").length();
+}
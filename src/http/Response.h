@@ -6,9 +6,15 @@
 #define EIRSERVER_RESPONSE_H
 
 #include <string>
+#include <string_view>
 #include <map>
+#include <memory>
+#include <vector>
+#include <sys/types.h>
 
 #include "HttpConstants.h"
+#include "../server/FileDescriptor.h"
+#include "../generators/Generator.h"
 
 using namespace std;
 
@@ -17,6 +23,73 @@ using namespace std;
  */
 class Response {
     public:
+        /**
+         * Struct holding one part of HTTP response to be sent, either data in memory, range of open file or
+         * streamed body.
+         */
+        struct segment {
+            /**
+             * Sets data in memory.
+             * @param[in] data_val Data to be sent.
+             */
+            segment(string data_val): data(move(data_val)), shared_data(nullptr), file(nullptr), offset(0), length(0) {}
+            /**
+             * Sets data in memory shared with other responses, so they are not copied.
+             * @param[in] data_val Data to be sent.
+             */
+            segment(shared_ptr<const string> data_val): shared_data(move(data_val)), file(nullptr), offset(0),
+                length(shared_data->length()) {}
+            /**
+             * Sets range of data in memory shared with other responses.
+             * @param[in] data_val Shared data.
+             * @param[in] offset_val Offset of first byte to be sent.
+             * @param[in] length_val Number of bytes to be sent.
+             */
+            segment(shared_ptr<const string> data_val, off_t offset_val, off_t length_val):
+                shared_data(move(data_val)), file(nullptr), offset(offset_val), length(length_val) {}
+            /**
+             * Sets range of open file.
+             * @param[in] file_val Open file to be sent.
+             * @param[in] offset_val Offset of first byte to be sent.
+             * @param[in] length_val Number of bytes to be sent.
+             */
+            segment(shared_ptr<FileDescriptor> file_val, off_t offset_val, off_t length_val):
+                shared_data(nullptr), file(file_val), offset(offset_val), length(length_val) {}
+            /**
+             * Sets streamed body, which is sent in chunks as generator produces them.
+             * @param[in] stream_val Generator with opened stream.
+             */
+            segment(shared_ptr<Generator> stream_val):
+                shared_data(nullptr), file(nullptr), stream(move(stream_val)), offset(0), length(0) {}
+            /**
+             * Gets data in memory to be sent.
+             * @return View of range of shared_data if it is set, data otherwise.
+             */
+            string_view get_data() const noexcept {
+                return (shared_data != nullptr) ? string_view(*shared_data).substr(offset, length) : string_view(data);
+            }
+            /** Member holding data in memory (used if file and shared_data are nullptr), current chunk of stream. */
+            string data;
+            /** Member holding shared data in memory (used if file is nullptr). */
+            shared_ptr<const string> shared_data;
+            /** Member holding open file which should be sent without copying it to memory. */
+            shared_ptr<FileDescriptor> file;
+            /** Member holding generator of streamed body, nullptr once its last chunk is in data. */
+            shared_ptr<Generator> stream;
+            /** Member holding offset of first byte of file or shared data to be sent. */
+            off_t offset;
+            /** Member holding number of bytes of file or shared data to be sent. */
+            off_t length;
+        };
+        /**
+         * Struct holding one range of response body requested by client.
+         */
+        struct range {
+            /** Member holding offset of first byte of range. */
+            off_t first;
+            /** Member holding offset of last byte of range. */
+            off_t last;
+        };
         /**
          * Sets value of given HTTP response header (in m_headers).
          * @param[in] header HTTP response header name.
@@ -39,14 +112,50 @@ class Response {
          */
         void set_body(const string &data) noexcept;
         /**
-         * Constructs string containing full HTTP response by appending all headers and body.
-         * @return String containing full HTTP response.
+         * Sets body of HTTP response to whole open file (m_body_file), which will be sent directly from kernel.
+         * @param[in] file Open file.
+         * @param[in] length Size of file.
+         */
+        void set_body_file(shared_ptr<FileDescriptor> file, const off_t &length) noexcept;
+        /**
+         * Sets body of HTTP response to data shared with cache (m_body_data), which will be sent without copying.
+         * @param[in] data Data of response body.
+         */
+        void set_body_data(shared_ptr<const string> data) noexcept;
+        /**
+         * Sets body of HTTP response to stream (m_body_stream), which is sent with chunked transfer coding
+         * while it is being generated.
+         * @param[in] stream Generator of streamed body, its stream is opened only if body will be sent.
+         */
+        void set_body_stream(shared_ptr<Generator> stream) noexcept;
+        /**
+         * Gets size of whole response body.
+         * @return Size of body in bytes.
          */
-        string construct() noexcept;
+        off_t get_body_length() const noexcept;
+        /**
+         * Sets ranges of body sent in response with HttpConstants::CODE_PARTIAL_CONTENT (m_ranges). One range is
+         * sent as it is, more ranges are sent as multipart/byteranges.
+         * @param[in] ranges Satisfiable ranges of body.
+         */
+        void set_ranges(const vector<range> &ranges) noexcept;
+        /**
+         * Constructs full HTTP response by appending all headers and body.
+         * @return Vector of segments, first one holds headers, following ones (if present) hold body in memory,
+         * shared, file or streamed body, or its ranges separated by multipart headers.
+         * @note Body in memory is moved to its segment, so response has to be reset before it is constructed again.
+         */
+        vector<segment> construct() noexcept;
         /**
          * Clears all members.
          */
         void reset() noexcept;
+        /**
+         * Gets position of Date header value in constructed response, it is always in the third line.
+         * @param[in] code Code of constructed response.
+         * @return Position of first character of date.
+         */
+        static size_t get_date_offset(const string &code) noexcept;
     private:
         /** Member map holding all HTTP response headers. */
         map<string, string> m_headers;
@@ -56,11 +165,33 @@ class Response {
         string m_code;
         /** Member holding HTTP response body. */
         string m_body;
+        /** Member holding HTTP response body sent from open file. */
+        shared_ptr<FileDescriptor> m_body_file;
+        /** Member holding size of HTTP response body sent from open file. */
+        off_t m_body_file_length;
+        /** Member holding HTTP response body shared with cache. */
+        shared_ptr<const string> m_body_data;
+        /** Member holding generator of HTTP response body of unknown length. */
+        shared_ptr<Generator> m_body_stream;
+        /** Member holding ranges of body to be sent. */
+        vector<range> m_ranges;
+        /**
+         * Appends data in memory to response, data are merged with previous segment if it is in memory too.
+         * @param[in,out] segments Segments of response.
+         * @param[in] data Data to be appended.
+         */
+        static void append_data(vector<segment> &segments, const string &data) noexcept;
+        /**
+         * Appends range of body to response without copying shared or file body.
+         * @param[in,out] segments Segments of response.
+         * @param[in] body_range Range of body to be appended.
+         */
+        void append_body(vector<segment> &segments, const struct range &body_range) const noexcept;
         /**
-         * Gets current date and time.
-         * @return String containing current date and time in format "%a, %d %b %Y %T GMT".
+         * Gets boundary separating parts of multipart/byteranges body, unique enough not to appear in body.
+         * @return String containing boundary.
          */
-        string get_date() noexcept;
+        static string get_boundary() noexcept;
 };
 
 
@@ -0,0 +1,83 @@
+//
+// Created by satopja2 on 17.10.26.
+//
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "Scanner.h"
+
+const Scanner::find_function Scanner::find_impl = Scanner::select();
+
+size_t Scanner::find(const string_view &data, const size_t &pos, const char &first, const char &second) noexcept {
+    if (pos >= data.length())
+        return string_view::npos;
+    return find_impl(data.data(), data.length(), pos, first, second);
+}
+
+size_t Scanner::find_head_end(const string_view &data, const size_t &pos) noexcept {
+    size_t pos_end = pos;
+
+    // Only '\r' can start empty line, check the rest of it around every one we find
+    while ((pos_end = find(data, pos_end, '\r', '\r')) != string_view::npos) {
+        if (data.compare(pos_end, 4, "\r\n\r\n") == 0)
+            return pos_end;
+        pos_end++;
+    }
+
+    return string_view::npos;
+}
+
+Scanner::find_function Scanner::select() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return find_avx2;
+    if (__builtin_cpu_supports("sse4.2"))
+        return find_sse42;
+#endif
+    return find_scalar;
+}
+
+size_t Scanner::find_scalar(const char *data, size_t length, size_t pos, char first, char second) noexcept {
+    for (; pos < length; pos++)
+        if (data[pos] == first || data[pos] == second)
+            return pos;
+    return string_view::npos;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse4.2")))
+size_t Scanner::find_sse42(const char *data, size_t length, size_t pos, char first, char second) noexcept {
+    const __m128i needles = _mm_setr_epi8(first, second, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    int index = 0;
+
+    // Compare whole 16 byte blocks with both needles at once, the rest is compared one byte at a time
+    for (; pos + 16 <= length; pos += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        index = _mm_cmpestri(needles, 2, block, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY);
+        if (index < 16)
+            return pos + index;
+    }
+
+    return find_scalar(data, length, pos, first, second);
+}
+
+__attribute__((target("avx2")))
+size_t Scanner::find_avx2(const char *data, size_t length, size_t pos, char first, char second) noexcept {
+    const __m256i first_mask = _mm256_set1_epi8(first), second_mask = _mm256_set1_epi8(second);
+    unsigned int found = 0;
+
+    // Compare whole 32 byte blocks with both needles, the rest is compared one byte at a time
+    for (; pos + 32 <= length; pos += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+        found = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(block, first_mask),
+                _mm256_cmpeq_epi8(block, second_mask)));
+        if (found != 0)
+            return pos + __builtin_ctz(found);
+    }
+
+    return find_scalar(data, length, pos, first, second);
+}
+#endif
@@ -0,0 +1,64 @@
+//
+// Created by satopja2 on 17.10.26.
+//
+
+#ifndef EIRSERVER_SCANNER_H
+#define EIRSERVER_SCANNER_H
+
+#include <string_view>
+#include <cstddef>
+
+using namespace std;
+
+/**
+ * Helper class locating token delimiters in request data several bytes at a time.
+ * @note Implementation is chosen once at startup by CPU features. AVX2 compares 32 bytes and SSE4.2 16 bytes
+ * at once, other CPUs use scalar fallback. All implementations return the same results.
+ */
+class Scanner {
+    public:
+        /**
+         * Finds first occurrence of any of two characters in data.
+         * @param[in] data Data to be searched.
+         * @param[in] pos Position from which to search.
+         * @param[in] first First searched character.
+         * @param[in] second Second searched character (may be the same as first).
+         * @return Position of first found character or string_view::npos if none of them was found.
+         */
+        static size_t find(const string_view &data, const size_t &pos, const char &first, const char &second) noexcept;
+        /**
+         * Finds end of request head (empty line "\r\n\r\n") in data.
+         * @param[in] data Data to be searched.
+         * @param[in] pos Position from which to search.
+         * @return Position of empty line or string_view::npos if it was not found.
+         */
+        static size_t find_head_end(const string_view &data, const size_t &pos) noexcept;
+    private:
+        /** Benchmark measures every implementation, not only the one chosen for current CPU. */
+        friend class ScannerBenchmark;
+        /** Type of function implementing find(). */
+        using find_function = size_t (*)(const char*, size_t, size_t, char, char);
+        /** Static member holding implementation of find() chosen for current CPU. */
+        static const find_function find_impl;
+        /**
+         * Chooses implementation of find() supported by current CPU.
+         * @return Pointer to chosen implementation.
+         */
+        static find_function select() noexcept;
+        /**
+         * Scalar implementation of find() comparing one byte at a time.
+         */
+        static size_t find_scalar(const char *data, size_t length, size_t pos, char first, char second) noexcept;
+#if defined(__x86_64__) || defined(__i386__)
+        /**
+         * SSE4.2 implementation of find() comparing 16 bytes at a time using PCMPESTRI.
+         */
+        static size_t find_sse42(const char *data, size_t length, size_t pos, char first, char second) noexcept;
+        /**
+         * AVX2 implementation of find() comparing 32 bytes at a time.
+         */
+        static size_t find_avx2(const char *data, size_t length, size_t pos, char first, char second) noexcept;
+#endif
+};
+
+#endif //EIRSERVER_SCANNER_H
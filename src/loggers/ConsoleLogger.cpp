@@ -6,12 +6,13 @@
 
 #include "ConsoleLogger.h"
 
-ConsoleLogger::ConsoleLogger(const string &verbosity) {
-    m_verbosity = verbosity;
+ConsoleLogger::ConsoleLogger(const string &verbosity, const string &format, const string &overflow,
+        const size_t &buffer_size): Logger(verbosity, format, overflow, buffer_size) {
     if (m_verbosity == "none")
         return;
 
     log_message(WARNING, "Starting Eirserver!");
+    start_writer();
 
     return;
 }
@@ -21,35 +22,31 @@ ConsoleLogger::~ConsoleLogger() {
         return;
 
     log_message(WARNING, "Closing Eirserver!");
+    stop_writer();
 
     return;
 }
 
-void ConsoleLogger::log_message(const log_types &type, const string &message) noexcept {
-    if (m_verbosity == "none")
-        return;
-
-    // Prepare m_body
-    set_log_type(type);
-    m_body += "[" + get_date() + "]: " + message;
-
-    // Log m_body
-    if (type == ERROR) {
-        cerr << m_body << endl;
-        return;
+void ConsoleLogger::write_records(const vector<log_record> &records) noexcept {
+    string body, error_body;
+
+    for (const auto &record : records) {
+        if (record.type != ERROR) {
+            construct_body(record, body);
+            continue;
+        }
+
+        // Errors go to cerr, everything logged before them is written first
+        if (!body.empty()) {
+            cout << body << flush;
+            body.clear();
+        }
+        error_body.clear();
+        construct_body(record, error_body);
+        cerr << error_body << flush;
     }
-    cout << m_body << endl;
-
-    return;
-}
-
-void ConsoleLogger::log_http(const string &request, const string &response, const string &ip) noexcept {
-    if (m_verbosity == "none")
-        return;
-
-    // Prepare and log m_body
-    construct_body(request, response, ip);
-    cout << m_body << flush;
+    if (!body.empty())
+        cout << body << flush;
 
     return;
 }
\ No newline at end of file
@@ -13,29 +13,25 @@
 class ConsoleLogger: public Logger {
     public:
         /**
-         * Sets logger verbosity (m_verbosity) and logs start message to cout.
+         * Calls Logger() with given verbosity and ring buffer settings, logs start message and starts writer thread.
          * @param[in] verbosity Verbosity of logger.
+         * @param[in] format Format of written records ("text" or "json").
+         * @param[in] overflow What happens when ring buffer is full ("drop" or "block").
+         * @param[in] buffer_size Number of records ring buffer can hold.
+         * @see Logger
          */
-        ConsoleLogger(const string &verbosity);
+        ConsoleLogger(const string &verbosity, const string &format, const string &overflow, const size_t &buffer_size);
         /**
-         * Logs closing message to cout.
+         * Logs closing message and stops writer thread once everything is written.
          */
         ~ConsoleLogger();
+    protected:
         /**
-         * Gets current date and sets logged message type. Logs message to cout or cerr (for type ERROR).
-         * @param[in] type Type of logged message.
-         * @param[in] message Message text to be logged.
-         * @see set_log_type()
-         * @see get_date()
+         * Writes batch of records to cout in one write, messages of type ERROR go to cerr.
+         * @param[in] records Records in order in which they were pushed.
+         * @see construct_body()
          */
-        virtual void log_message(const log_types &type, const string &message) noexcept override;
-        /**
-         * Logs minimal HTTP request and response code to cout. In verbose mode includes HTTP headers.
-         * @param[in] request HTTP request data received from client.
-         * @param[in] response HTTP response data sent by server.
-         * @param[in] ip IP of client.
-         */
-        virtual void log_http(const string &request, const string &response, const string &ip) noexcept override;
+        virtual void write_records(const vector<log_record> &records) noexcept override;
 };
 
 #endif //EIRSERVER_CONSOLE_LOGGER_H
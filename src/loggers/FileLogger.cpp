@@ -4,20 +4,26 @@
 
 #include <syslog.h>
 #include <stdexcept>
+#include <system_error>
+#include <cstdio>
+#include <sys/stat.h>
+#include <zlib.h>
 
 #include "FileLogger.h"
 
-FileLogger::FileLogger(const string &verbosity, const string &log_file) {
-    m_verbosity = verbosity;
+FileLogger::FileLogger(const string &verbosity, const string &log_file, const string &format,
+        const string &overflow, const size_t &buffer_size, const off_t &max_size, const unsigned int &keep,
+        const bool &compress): Logger(verbosity, format, overflow, buffer_size), m_log_path(log_file), m_size(0),
+        m_max_size(max_size), m_keep(keep), m_compress(compress) {
     if (m_verbosity == "none")
         return;
 
     // Try to open log file
-    m_log_file.open(log_file, ios::out | ios::app);
-    if (!m_log_file.is_open())
+    if (!open_log())
         throw runtime_error("unable to open log file");
 
     log_message(WARNING, "Starting Eirserver!");
+    start_writer();
 
     return;
 }
@@ -27,54 +33,142 @@ FileLogger::~FileLogger() {
         return;
 
     log_message(WARNING, "Closing Eirserver!");
+    stop_writer();
+    if (m_compression.joinable())
+        m_compression.join();
 
     // Try to close log file
     m_log_file.clear();
     m_log_file.close();
-    if (m_log_file.fail()) {
-        openlog("Eirserver", LOG_PID | LOG_PERROR, LOG_USER);
-        syslog(LOG_ERR, "%s", "Error while closing log file!");
-        closelog();
-    }
+    if (m_log_file.fail())
+        report_error("Error while closing log file!");
 
     return;
 }
 
-void FileLogger::log_message(const log_types &type, const string &message) noexcept {
-    if (m_verbosity == "none")
-        return;
+void FileLogger::write_records(const vector<log_record> &records) noexcept {
+    // Prepare body of whole batch
+    string body;
+    for (const auto &record : records)
+        construct_body(record, body);
 
-    // Prepare m_body
-    set_log_type(type);
-    m_body += "[" + get_date() + "]: " + message;
+    // Whole batch goes to one file
+    if (m_max_size > 0 && m_size > 0 && m_size + static_cast<off_t>(body.length()) > m_max_size)
+        rotate();
 
     // Try to log to file
     m_log_file.clear();
-    m_log_file << m_body << endl;
-    if (m_log_file.fail()) {
-        openlog("Eirserver", LOG_PID | LOG_PERROR, LOG_USER);
-        syslog(LOG_ERR, "%s", "Error while writing to log file!");
-        closelog();
-    }
+    m_log_file << body << flush;
+    if (m_log_file.fail())
+        report_error("Error while writing to log file!");
+    else
+        m_size += body.length();
 
     return;
 }
 
-void FileLogger::log_http(const string &request, const string &response, const string &ip) noexcept {
-    if (m_verbosity == "none")
+void FileLogger::rotate_output() noexcept {
+    // Log file was already moved away by external tool
+    if (m_keep == 0) {
+        m_log_file.close();
+        if (!open_log())
+            report_error("Error while reopening log file!");
         return;
+    }
 
-    // Prepare m_body
-    construct_body(request, response, ip);
+    rotate();
+    return;
+}
+
+bool FileLogger::open_log() noexcept {
+    struct stat file_status;
 
-    // Try to log to file
     m_log_file.clear();
-    m_log_file << m_body << flush;
-    if (m_log_file.fail()) {
-        openlog("Eirserver", LOG_PID | LOG_PERROR, LOG_USER);
-        syslog(LOG_ERR, "%s", "Error while writing to log file!");
-        closelog();
+    m_log_file.open(m_log_path, ios::out | ios::app);
+    if (!m_log_file.is_open())
+        return false;
+    m_size = (stat(m_log_path.c_str(), &file_status) == 0) ? file_status.st_size : 0;
+
+    return true;
+}
+
+void FileLogger::rotate() noexcept {
+    m_log_file.close();
+
+    // Older rotated files are shifted only after their compression is finished
+    if (m_compression.joinable())
+        m_compression.join();
+
+    // Nothing is kept, log file is only emptied
+    if (m_keep == 0) {
+        m_log_file.clear();
+        m_log_file.open(m_log_path, ios::out | ios::trunc);
+        m_size = 0;
+        if (!m_log_file.is_open())
+            report_error("Error while reopening log file!");
+        return;
     }
 
+    // Oldest rotated file is removed, the rest is shifted by one (missing ones are skipped)
+    remove(get_rotated_path(m_keep, false).c_str());
+    remove(get_rotated_path(m_keep, true).c_str());
+    for (unsigned int i = m_keep - 1; i >= 1; i--) {
+        rename(get_rotated_path(i, false).c_str(), get_rotated_path(i + 1, false).c_str());
+        rename(get_rotated_path(i, true).c_str(), get_rotated_path(i + 1, true).c_str());
+    }
+
+    if (rename(m_log_path.c_str(), get_rotated_path(1, false).c_str()) != 0)
+        report_error("Error while rotating log file!");
+    else if (m_compress) {
+        try {
+            m_compression = thread(&FileLogger::compress_file, get_rotated_path(1, false));
+        } catch (const system_error& e) {
+            report_error("Unable to start compression of rotated log file!");
+        }
+    }
+
+    if (!open_log())
+        report_error("Error while reopening log file!");
+
+    return;
+}
+
+string FileLogger::get_rotated_path(const unsigned int &index, const bool &compressed) const noexcept {
+    return m_log_path + "." + to_string(index) + (compressed ? ".gz" : "");
+}
+
+void FileLogger::compress_file(const string &path) noexcept {
+    char buffer[65536];
+    bool success = true;
+    ifstream input(path, ios::in | ios::binary);
+    gzFile output = gzopen((path + ".gz").c_str(), "wb");
+
+    if (!input.is_open() || output == nullptr) {
+        if (output != nullptr)
+            gzclose(output);
+        report_error("Error while compressing rotated log file!");
+        return;
+    }
+
+    // Copy whole file through gzip stream
+    while (success && (input.read(buffer, sizeof(buffer)) || input.gcount() > 0))
+        success = gzwrite(output, buffer, input.gcount()) == input.gcount();
+    success = gzclose(output) == Z_OK && success && !input.bad();
+
+    // Only one of them is kept
+    if (success)
+        remove(path.c_str());
+    else {
+        remove((path + ".gz").c_str());
+        report_error("Error while compressing rotated log file!");
+    }
+
+    return;
+}
+
+void FileLogger::report_error(const char *message) noexcept {
+    openlog("Eirserver", LOG_PID | LOG_PERROR, LOG_USER);
+    syslog(LOG_ERR, "%s", message);
+    closelog();
     return;
 }
\ No newline at end of file
@@ -7,45 +7,95 @@
 
 #include <string>
 #include <fstream>
+#include <thread>
+#include <sys/types.h>
 
 #include "Logger.h"
 
 /**
  * Logger type class logging to file.
+ * @note Log file is rotated by writer thread once it would grow over \ref LogMaxSize "log_max_size" or when SIGUSR1
+ * is catched, so workers never wait for it. Rotated files are compressed in their own thread.
  */
 class FileLogger: public Logger {
     public:
         /**
-         * Sets logger verbosity (m_verbosity), opens log file and logs start message.
+         * Calls Logger() with given verbosity and ring buffer settings, sets rotation of log file, opens log file, logs
+         * start message and starts writer thread.
          * @param[in] verbosity Verbosity of logger.
          * @param[in] log_file %Path to log file.
+         * @param[in] format Format of written records ("text" or "json").
+         * @param[in] overflow What happens when ring buffer is full ("drop" or "block").
+         * @param[in] buffer_size Number of records ring buffer can hold.
+         * @param[in] max_size Size in bytes at which log file is rotated (0 rotates only on SIGUSR1).
+         * @param[in] keep Number of kept rotated files (0 keeps none, SIGUSR1 then only reopens log file).
+         * @param[in] compress Whether rotated files are compressed with gzip.
          * @throw runtime_error If log file cannot be opened.
+         * @see Logger
          */
-        FileLogger(const string &verbosity, const string &log_file);
+        FileLogger(const string &verbosity, const string &log_file, const string &format, const string &overflow,
+                const size_t &buffer_size, const off_t &max_size, const unsigned int &keep, const bool &compress);
         /**
-         * Logs closing message and closes log file. If closing log file fails it makes note of that to syslog and cerr.
+         * Logs closing message, stops writer thread once everything is written, waits for compression of rotated file
+         * and closes log file. If closing log file fails it makes note of that to syslog and cerr.
          */
         ~FileLogger();
+    protected:
         /**
-         * Gets current date and sets logged message type. Logs message to log file. If logging to file fails
-         * it makes note of that to syslog and cerr.
-         * @param[in] type Type of logged message.
-         * @param[in] message Message text to be logged.
-         * @see set_log_type()
-         * @see get_date()
+         * Writes batch of records to log file in one write, rotates log file first if batch would make it grow over
+         * m_max_size. If logging to file fails it makes note of that to syslog and cerr.
+         * @param[in] records Records in order in which they were pushed.
+         * @see construct_body()
          */
-        virtual void log_message(const log_types &type, const string &message) noexcept override;
+        virtual void write_records(const vector<log_record> &records) noexcept override;
         /**
-         * Logs minimal HTTP request and response code to log file. In verbose mode includes HTTP headers. If logging
-         * to file fails it makes note of that to syslog and cerr.
-         * @param[in] request HTTP request data received from client.
-         * @param[in] response HTTP response data sent by server.
-         * @param[in] ip IP of client.
+         * Rotates log file on request of SIGUSR1, only reopens it if no rotated files are kept, so it can be rotated
+         * by external tool.
+         * @see rotate()
          */
-        virtual void log_http(const string &request, const string &response, const string &ip) noexcept override;
+        virtual void rotate_output() noexcept override;
     private:
-        /** Member holding log file output stream. */
+        /** Member holding log file output stream, written only by writer thread. */
         ofstream m_log_file;
+        /** Member holding path to log file. */
+        string m_log_path;
+        /** Member holding current size of log file. */
+        off_t m_size;
+        /** Member holding size at which log file is rotated (0 rotates only on SIGUSR1). */
+        off_t m_max_size;
+        /** Member holding number of kept rotated files. */
+        unsigned int m_keep;
+        /** Member holding whether rotated files are compressed. */
+        bool m_compress;
+        /** Member holding thread compressing last rotated file. */
+        thread m_compression;
+        /**
+         * Opens log file for appending and gets its current size.
+         * @return true if log file was opened, false otherwise.
+         */
+        bool open_log() noexcept;
+        /**
+         * Closes log file, renames it to first rotated file ("log_file.1") after shifting older rotated files by one,
+         * and opens new log file. Oldest rotated file over m_keep is removed. Without kept files log file is emptied.
+         */
+        void rotate() noexcept;
+        /**
+         * Gets path of rotated file.
+         * @param[in] index Index of rotated file (1 is the newest).
+         * @param[in] compressed Whether path of compressed file is wanted.
+         * @return String containing path of rotated file.
+         */
+        string get_rotated_path(const unsigned int &index, const bool &compressed) const noexcept;
+        /**
+         * Compresses file with gzip to file with ".gz" appended and removes it, runs in m_compression thread.
+         * @param[in] path %Path to file.
+         */
+        static void compress_file(const string &path) noexcept;
+        /**
+         * Makes note of error to syslog and cerr, because log file itself cannot be used.
+         * @param[in] message Message text.
+         */
+        static void report_error(const char *message) noexcept;
 };
 
 
@@ -2,121 +2,474 @@
 // Created by satopja2 on 28.03.20.
 //
 
-#include <ctime>
-#include <sstream>
+#include <strings.h>
 
 #include "Logger.h"
+#include "../server/Clock.h"
 
-string Logger::get_date() noexcept {
-    string date;
-    time_t time_obj = time(nullptr);
-    char date_c_str[20];
+volatile sig_atomic_t Logger::rotate_requested = 0;
 
-    // Get current date and time
-    strftime(date_c_str, sizeof(date_c_str), "%d.%m.%Y %T", localtime(&time_obj));
-    date.append(date_c_str);
+Logger::Logger(const string &verbosity, const string &format, const string &overflow, const size_t &buffer_size):
+    m_verbosity(verbosity), m_sample(1), m_slow_time(0), m_rate_limit(0), m_json(format == "json"),
+    m_blocking(overflow == "block"), m_push_position(0), m_pop_position(0), m_dropped(0), m_writer_sleeping(false),
+    m_stop(false) {
+    size_t slots_count = 1;
 
-    return date;
+    // Slot index is masked position, so number of slots is power of two
+    while (slots_count < buffer_size)
+        slots_count <<= 1;
+    m_slots = make_unique<slot[]>(slots_count);
+    m_mask = slots_count - 1;
+    m_wake_mask = (slots_count > 1) ? slots_count / 2 - 1 : 0;
+    for (size_t i = 0; i < slots_count; i++)
+        m_slots[i].sequence.store(i, memory_order_relaxed);
+    for (auto &window : m_rate_windows) {
+        window.second.store(0, memory_order_relaxed);
+        window.count.store(0, memory_order_relaxed);
+        window.suppressed.store(0, memory_order_relaxed);
+    }
+}
+
+Logger::~Logger() {
+    stop_writer();
+}
+
+void Logger::set_filters(const unsigned int &sample, const chrono::microseconds &slow_time,
+        const unsigned int &rate_limit) noexcept {
+    m_sample = (sample > 0) ? sample : 1;
+    m_slow_time = slow_time;
+    m_rate_limit = rate_limit;
+    return;
+}
+
+void Logger::log_message(const log_types &type, const string &message) noexcept {
+    time_t now = time(nullptr);
+
+    if (m_verbosity == "none" || !is_within_rate(type, now))
+        return;
+
+    log_record record;
+    record.type = type;
+    record.time = now;
+    record.bytes = 0;
+    record.duration = 0;
+    record.message = message;
+    push_record(record);
+
+    return;
+}
+
+void Logger::log_http(const RequestParser &request, const string &ip, const string &code, const size_t &bytes,
+        const chrono::microseconds &duration, const string_view &response_head) noexcept {
+    thread_local unsigned int sampled = 0;
+    size_t line_start = 0, line_end = 0, separator = 0;
+    string_view value;
+
+    if (m_verbosity == "none")
+        return;
+
+    // Errors (4xx, 5xx) and slow requests are always logged, sampling counter is per worker to avoid sharing it
+    if (m_sample > 1 && code[0] < '4' && (m_slow_time.count() == 0 || duration < m_slow_time)) {
+        if (++sampled < m_sample)
+            return;
+        sampled = 0;
+    }
+
+    log_record record;
+    record.type = HTTP;
+    record.time = time(nullptr);
+    record.ip = ip;
+    record.method = request.get_method();
+    record.path = request.get_target();
+    record.version = request.get_version();
+    record.status = code;
+    record.bytes = bytes;
+    record.duration = duration.count();
+    if (request.find_header("Referer", value))
+        record.referer = value;
+    if (request.find_header("User-Agent", value))
+        record.user_agent = value;
+
+    // Request data are gone once writer thread gets to record, so headers are copied
+    if (m_verbosity == "verbose") {
+        for (const auto &request_header : request.get_headers())
+            record.request_headers.emplace_back(request_header.name, request_header.value);
+
+        // Skip status line, response headers end with empty line before body
+        line_start = response_head.find("\r\n");
+        while (line_start != string_view::npos) {
+            line_start += 2;
+            line_end = response_head.find("\r\n", line_start);
+            if (line_end == string_view::npos || line_end == line_start)
+                break;
+            separator = response_head.find(": ", line_start);
+            if (separator != string_view::npos && separator < line_end)
+                record.response_headers.emplace_back(response_head.substr(line_start, separator - line_start),
+                        response_head.substr(separator + 2, line_end - separator - 2));
+            line_start = line_end;
+        }
+    }
+    push_record(record);
+
+    return;
+}
+
+void Logger::start_writer() {
+    if (m_verbosity == "none")
+        return;
+
+    m_writer = thread(&Logger::run_writer, this);
+    return;
+}
+
+void Logger::stop_writer() noexcept {
+    if (!m_writer.joinable())
+        return;
+
+    {
+        lock_guard<mutex> lock(m_writer_lock);
+        m_stop = true;
+        m_writer_sleeping.store(false);
+    }
+    m_writer_cv.notify_one();
+    m_writer.join();
+
+    return;
 }
 
-void Logger::set_log_type(const log_types &type) noexcept {
+void Logger::set_log_type(const log_types &type, string &body) noexcept {
     switch (type) {
         case ERROR:
-            m_body = "  ERROR ";
+            body += "  ERROR ";
             break;
         case WARNING:
-            m_body = "WARNING ";
+            body += "WARNING ";
             break;
         case INFO:
-            m_body = "   INFO ";
+            body += "   INFO ";
+            break;
+        case HTTP:
+            body += "   HTTP ";
             break;
     }
     return;
 }
 
-string Logger::extract_request_status(const string &request) noexcept {
-    string line;
-    istringstream request_stream(request);
-    getline(request_stream, line, '\r');
-    return line;
+void Logger::append_headers(const string &title, const vector<pair<string, string>> &headers,
+        const size_t &format_width, string &body) noexcept {
+    // Append title
+    body.append(format_width, ' ');
+    body += "##### " + title + " #####\n";
+
+    // Append headers
+    for (const auto &header : headers) {
+        body.append(format_width, ' ');
+        body += header.first + ": " + header.second + "\n";
+    }
+
+    return;
 }
 
-void Logger::append_request_headers(const string &request, const int &format_width) noexcept {
-    string line;
-    istringstream request_stream(request);
+void Logger::construct_body(const log_record &record, string &body) noexcept {
+    if (m_json)
+        construct_json_body(record, body);
+    else
+        construct_text_body(record, body);
+    return;
+}
 
-    // Skip first request line which we already included
-    getline(request_stream, line);
+void Logger::construct_text_body(const log_record &record, string &body) noexcept {
+    size_t format_width = body.length();
 
-    // Apend title
-    m_body.append(format_width, ' ');
-    m_body += "##### REQUEST HEADERS #####\n";
+    // Set minimal log body
+    set_log_type(record.type, body);
+    body += "[" + Clock::get_log_date(record.time) + "]: ";
+    format_width = body.length() - format_width;
+    if (record.type != HTTP) {
+        body += record.message + "\n";
+        return;
+    }
+    body += record.ip + " - \"" + record.method + " " + record.path + " " + record.version + "\" <- \"" + record.status
+            + "\" " + to_string(record.bytes) + " B " + to_string(record.duration) + " us\n";
 
-    // Append headers
-    while (getline(request_stream, line)) {
-        if (iscntrl(line[0]))
+    // Verbose headers
+    if (m_verbosity == "verbose") {
+        append_headers("REQUEST HEADERS", record.request_headers, format_width, body);
+        append_headers("RESPONSE HEADERS", record.response_headers, format_width, body);
+    }
+
+    return;
+}
+
+void Logger::construct_json_body(const log_record &record, string &body) noexcept {
+    body += "{\"time\":\"" + Clock::get_iso_date(record.time) + "\",\"type\":";
+    switch (record.type) {
+        case ERROR:
+            body += "\"error\"";
+            break;
+        case WARNING:
+            body += "\"warning\"";
+            break;
+        case INFO:
+            body += "\"info\"";
+            break;
+        case HTTP:
+            body += "\"http\"";
+            break;
+    }
+    if (record.type != HTTP) {
+        body += ",\"message\":";
+        append_json_string(record.message, body);
+        body += "}\n";
+        return;
+    }
+
+    // Status is number, its text is known from it
+    body += ",\"ip\":\"" + record.ip + "\",\"method\":";
+    append_json_string(record.method, body);
+    body += ",\"path\":";
+    append_json_string(record.path, body);
+    body += ",\"version\":";
+    append_json_string(record.version, body);
+    body += ",\"status\":" + record.status.substr(0, record.status.find(' ')) + ",\"bytes\":"
+            + to_string(record.bytes) + ",\"duration_us\":" + to_string(record.duration) + ",\"referer\":";
+    append_json_string(record.referer, body);
+    body += ",\"user_agent\":";
+    append_json_string(record.user_agent, body);
+    if (m_verbosity == "verbose") {
+        body += ",\"request_headers\":";
+        append_json_headers(record.request_headers, body);
+        body += ",\"response_headers\":";
+        append_json_headers(record.response_headers, body);
+    }
+    body += "}\n";
+
+    return;
+}
+
+void Logger::append_json_string(const string_view &value, string &body) noexcept {
+    static const char hex_digits[] = "0123456789abcdef";
+
+    body += '"';
+    for (const char &character : value) {
+        switch (character) {
+            case '"':
+                body += "\\\"";
+                break;
+            case '\\':
+                body += "\\\\";
+                break;
+            default:
+                // Control characters would break JSON line
+                if (static_cast<unsigned char>(character) < 0x20) {
+                    body += "\\u00";
+                    body += hex_digits[character >> 4];
+                    body += hex_digits[character & 0xf];
+                } else
+                    body += character;
+        }
+    }
+    body += '"';
+
+    return;
+}
+
+void Logger::append_json_headers(const vector<pair<string, string>> &headers, string &body) noexcept {
+    bool is_first = true, is_repeated = false;
+
+    body += '{';
+    for (size_t i = 0; i < headers.size(); i++) {
+        // Repeated header was already joined with its first occurrence
+        is_repeated = false;
+        for (size_t j = 0; j < i && !is_repeated; j++)
+            is_repeated = strcasecmp(headers[i].first.c_str(), headers[j].first.c_str()) == 0;
+        if (is_repeated)
             continue;
-        m_body.append(format_width, ' ');
-        m_body += line;
-        // Erase '\r' at end of line
-        m_body.erase(m_body.end()-1);
-        m_body += "\n";
+
+        string value = headers[i].second;
+        for (size_t j = i + 1; j < headers.size(); j++) {
+            if (strcasecmp(headers[i].first.c_str(), headers[j].first.c_str()) == 0)
+                value += ", " + headers[j].second;
+        }
+        if (!is_first)
+            body += ',';
+        is_first = false;
+        append_json_string(headers[i].first, body);
+        body += ':';
+        append_json_string(value, body);
     }
+    body += '}';
 
     return;
 }
 
-string Logger::extract_response_code(const string &response) noexcept {
-    // Example -> "HTTP/1.1 200 Ok\r\n"
-    string response_code;
-    int i = 0;
+bool Logger::is_within_rate(const log_types &type, const time_t &now) noexcept {
+    if (m_rate_limit == 0 || type == HTTP)
+        return true;
+
+    // First message in new second starts new window, windows are approximate when seconds change concurrently
+    rate_window &window = m_rate_windows[type];
+    time_t second = window.second.load(memory_order_relaxed);
+    if (second != now && window.second.compare_exchange_strong(second, now, memory_order_relaxed))
+        window.count.store(0, memory_order_relaxed);
+    if (window.count.fetch_add(1, memory_order_relaxed) < m_rate_limit)
+        return true;
+    window.suppressed.fetch_add(1, memory_order_relaxed);
+
+    return false;
+}
+
+void Logger::report_suppressed(vector<log_record> &records, const bool &is_final) noexcept {
+    static const char *type_names[HTTP] = {"error", "warning", "info"};
+    time_t now = time(nullptr);
+    size_t suppressed = 0;
+
+    for (int type = ERROR; type < HTTP; type++) {
+        // Messages of current second may still be suppressed, they are reported once it ends
+        rate_window &window = m_rate_windows[type];
+        if (window.suppressed.load(memory_order_relaxed) == 0
+                || (!is_final && window.second.load(memory_order_relaxed) == now))
+            continue;
+        suppressed = window.suppressed.exchange(0, memory_order_relaxed);
 
-    // Start of code is always at index 9 (1st line has always minimally "HTTP/1.1 \r\n")
-    while(response[i+9] != '\r') {
-        response_code.append(response, i+9, 1);
-        i++;
+        log_record record;
+        record.type = WARNING;
+        record.time = now;
+        record.bytes = 0;
+        record.duration = 0;
+        record.message = "Suppressed " + to_string(suppressed) + " similar " + type_names[type] + " messages";
+        records.push_back(move(record));
     }
 
-    return response_code;
+    return;
 }
 
-void Logger::append_response_headers(const string &response, const int &format_width) noexcept {
-    string line;
-    istringstream response_stream(response);
+void Logger::push_record(log_record &record) noexcept {
+    size_t position = 0;
+    bool is_http = record.type == HTTP;
 
-    // Skip first response line which we already included
-    getline(response_stream, line);
+    // Full ring buffer either drops record or waits until writer thread frees slot
+    while (!try_push(record, position)) {
+        wake_writer();
+        if (!m_blocking) {
+            m_dropped.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+        this_thread::yield();
+    }
 
-    // Append title
-    m_body.append(format_width, ' ');
-    m_body += "##### RESPONSE HEADERS #####\n";
+    // HTTP records are batched, writer thread is woken only once per half of ring buffer
+    if (!is_http || (position & m_wake_mask) == 0)
+        wake_writer();
 
-    // Append headers
-    while (getline(response_stream, line)) {
-        if (iscntrl(line[0]))
-            break;
-        m_body.append(format_width, ' ');
-        m_body += line;
-        // Erase '\r' at end of line
-        m_body.erase(m_body.end()-1);
-        m_body += "\n";
+    return;
+}
+
+bool Logger::try_push(log_record &record, size_t &position) noexcept {
+    position = m_push_position.load(memory_order_relaxed);
+
+    while (true) {
+        slot &current = m_slots[position & m_mask];
+        size_t sequence = current.sequence.load(memory_order_acquire);
+        long long difference = static_cast<long long>(sequence) - static_cast<long long>(position);
+
+        // Slot is free, claim its position before other workers
+        if (difference == 0) {
+            if (m_push_position.compare_exchange_weak(position, position + 1, memory_order_relaxed)) {
+                current.record = move(record);
+                current.sequence.store(position + 1, memory_order_release);
+                return true;
+            }
+        // Slot was not popped yet, ring buffer is full
+        } else if (difference < 0)
+            return false;
+        // Other worker claimed position first
+        else
+            position = m_push_position.load(memory_order_relaxed);
+    }
+}
+
+bool Logger::try_pop(log_record &record) noexcept {
+    slot &current = m_slots[m_pop_position & m_mask];
+
+    if (current.sequence.load(memory_order_acquire) != m_pop_position + 1)
+        return false;
+    record = move(current.record);
+    current.sequence.store(m_pop_position + m_mask + 1, memory_order_release);
+    m_pop_position++;
+
+    return true;
+}
+
+bool Logger::is_empty() const noexcept {
+    return m_slots[m_pop_position & m_mask].sequence.load(memory_order_acquire) != m_pop_position + 1;
+}
+
+void Logger::wake_writer() noexcept {
+    // Pairs with fence in run_writer(), so either writer sees pushed record or we see it sleeping
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!m_writer_sleeping.load(memory_order_relaxed))
+        return;
+
+    {
+        lock_guard<mutex> lock(m_writer_lock);
+        m_writer_sleeping.store(false, memory_order_relaxed);
     }
+    m_writer_cv.notify_one();
 
     return;
 }
 
-void Logger::construct_body(const string &request, const string &response, const string &ip) noexcept {
-    int format_width = 0;
+void Logger::run_writer() noexcept {
+    vector<log_record> records;
+    log_record record;
+    size_t dropped = 0;
 
-    // Set minimal HTTP log m_body
-    m_body = "   HTTP [" + get_date() + "]: ";
-    format_width = m_body.length();
-    m_body += ip + " - \"" + extract_request_status(request) + "\" <- \"" + extract_response_code(response) + "\"\n";
+    records.reserve(max_batch);
+    while (true) {
+        // Signal handler cannot touch output, so rotation is done here
+        if (Logger::rotate_requested) {
+            Logger::rotate_requested = 0;
+            rotate_output();
+        }
 
-    if (m_verbosity == "verbose") {
-        append_request_headers(request, format_width);
-        append_response_headers(response, format_width);
+        // Take batch of records and write it at once
+        while (records.size() < max_batch && try_pop(record))
+            records.push_back(move(record));
+        dropped = m_dropped.exchange(0, memory_order_relaxed);
+        if (dropped > 0) {
+            record = log_record();
+            record.type = WARNING;
+            record.time = time(nullptr);
+            record.message = "Log buffer full, dropped " + to_string(dropped) + " messages";
+            records.push_back(move(record));
+        }
+        report_suppressed(records, false);
+        if (!records.empty()) {
+            write_records(records);
+            records.clear();
+            continue;
+        }
+
+        // Wait until worker pushes record
+        unique_lock<mutex> lock(m_writer_lock);
+        if (m_stop && is_empty()) {
+            lock.unlock();
+            report_suppressed(records, true);
+            if (!records.empty())
+                write_records(records);
+            break;
+        }
+        m_writer_sleeping.store(true, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (!is_empty() || m_dropped.load(memory_order_relaxed) > 0) {
+            m_writer_sleeping.store(false, memory_order_relaxed);
+            continue;
+        }
+        m_writer_cv.wait_for(lock, flush_interval,
+                [this] { return !m_writer_sleeping.load(memory_order_relaxed) || m_stop; });
+        m_writer_sleeping.store(false, memory_order_relaxed);
     }
 
     return;
-}
\ No newline at end of file
+}
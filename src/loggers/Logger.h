@@ -6,91 +6,297 @@
 #define EIRSERVER_LOGGER_H
 
 #include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <ctime>
+#include <csignal>
+
+#include "../http/RequestParser.h"
 
 using namespace std;
 
 /**
  * Abstract class for logger types.
+ * @note Workers only push compact log records into bounded ring buffer shared by all of them, records are
+ * formatted and written in batches by background writer thread, so no worker waits for log output. Writer
+ * thread is woken for every message, but HTTP records only wait until it wakes up by itself or half of ring
+ * buffer is filled. Successful HTTP records may be sampled and messages are rate limited per type before they
+ * are pushed, so floods cost workers almost nothing.
  */
 class Logger {
     public:
+        /** Static member set by SIGUSR1 handler, writer thread rotates output once it notices it. */
+        static volatile sig_atomic_t rotate_requested;
         /**
-         * Default destructor.
+         * Stops writer thread if concrete logger did not stop it.
          */
-        virtual ~Logger() = default;
+        virtual ~Logger();
         /**
          * Enum holding types of log messages.
          */
         enum log_types {
             ERROR,
             WARNING,
-            INFO
+            INFO,
+            HTTP
         };
         /**
-         * Pure virtual function. Logs message.
+         * Sets sampling of HTTP records and rate limiting of messages, called before workers start.
+         * @param[in] sample Only every sample-th successful HTTP request is logged (1 logs all).
+         * @param[in] slow_time Requests handled at least this long are always logged (0 disables it).
+         * @param[in] rate_limit Maximum number of messages of one type logged per second (0 disables limit).
+         */
+        void set_filters(const unsigned int &sample, const chrono::microseconds &slow_time,
+                const unsigned int &rate_limit) noexcept;
+        /**
+         * Pushes message into ring buffer, unless more than m_rate_limit messages of its type were logged in current
+         * second. Suppressed messages are counted and reported by writer thread.
          * @param[in] type Type of logged message.
          * @param[in] message Message text to be logged.
+         * @see push_record()
          */
-        virtual void log_message(const log_types &type, const string &message) noexcept = 0;
+        void log_message(const log_types &type, const string &message) noexcept;
         /**
-         * Pure virtual function. Logs HTTP request and response.
-         * @param[in] request HTTP request data received from client.
-         * @param[in] response HTTP response data sent by server.
+         * Pushes fields of HTTP request and response into ring buffer. Fields are copied right away, because
+         * request data are not valid after it is handled. Headers are copied only in \ref Verbosity "verbose" mode.
+         * Successful fast requests are sampled, errors and slow requests are always logged.
+         * @param[in] request Parsed HTTP request received from client.
          * @param[in] ip IP of client.
+         * @param[in] code HTTP response code (example: "304 Not Modified").
+         * @param[in] bytes Size of response in bytes (without streamed body).
+         * @param[in] duration Time spent handling request.
+         * @param[in] response_head Status line and headers of HTTP response, only read in verbose mode.
+         * @see push_record()
          */
-        virtual void log_http(const string &request, const string &response, const string &ip) noexcept = 0;
+        void log_http(const RequestParser &request, const string &ip, const string &code, const size_t &bytes,
+                const chrono::microseconds &duration, const string_view &response_head) noexcept;
     protected:
+        /**
+         * Struct holding one logged message until writer thread writes it.
+         */
+        struct log_record {
+            /** Member holding type of logged message. */
+            log_types type;
+            /** Member holding time at which message was logged. */
+            time_t time;
+            /** Member holding IP of client (only HTTP). */
+            string ip;
+            /** Member holding requested method (only HTTP). */
+            string method;
+            /** Member holding requested target (only HTTP). */
+            string path;
+            /** Member holding requested HTTP version (only HTTP). */
+            string version;
+            /** Member holding response code, for example "200 Ok" (only HTTP). */
+            string status;
+            /** Member holding value of Referer header (only HTTP). */
+            string referer;
+            /** Member holding value of User-Agent header (only HTTP). */
+            string user_agent;
+            /** Member holding size of response in bytes (only HTTP). */
+            size_t bytes;
+            /** Member holding time spent handling request in microseconds (only HTTP). */
+            long long duration;
+            /** Member holding message text (only messages). */
+            string message;
+            /** Member holding request headers as name and value (only HTTP in verbose mode). */
+            vector<pair<string, string>> request_headers;
+            /** Member holding response headers as name and value (only HTTP in verbose mode). */
+            vector<pair<string, string>> response_headers;
+        };
+        /**
+         * Sets verbosity, output format, overflow policy and size of ring buffer.
+         * @param[in] verbosity Verbosity of logger.
+         * @param[in] format Format of written records ("text" or "json").
+         * @param[in] overflow What happens when ring buffer is full ("drop" or "block").
+         * @param[in] buffer_size Number of records ring buffer can hold, rounded up to power of two.
+         */
+        Logger(const string &verbosity, const string &format, const string &overflow, const size_t &buffer_size);
         /** Member holding verbosity of logger. */
         string m_verbosity;
-        /** Member holding body of logged message. */
-        string m_body;
         /**
-         * Gets current date and time.
-         * @return String containing current date and time in format "%d.%m.%Y %T".
+         * Starts writer thread (m_writer), concrete logger calls it once it is ready to write.
          */
-        string get_date() noexcept;
+        void start_writer();
         /**
-         * Appends type of logged message to m_body.
-         * @param[in] type Type of logged message.
+         * Stops writer thread after it writes all pushed records, concrete logger calls it before it is destroyed.
          */
-        virtual void set_log_type(const log_types &type) noexcept;
+        void stop_writer() noexcept;
         /**
-         * Extracts request status line (example: "GET /favicon.ico HTTP/1.1").
-         * @param[in] request Data of HTTP request.
-         * @return String containing minimal request in format "HTTP_METHOD REQUEST_PATH".
+         * Pure virtual function. Writes batch of records to output, called only by writer thread.
+         * @param[in] records Records in order in which they were pushed.
          */
-        string extract_request_status(const string &request) noexcept;
+        virtual void write_records(const vector<log_record> &records) noexcept = 0;
         /**
-         * Extracts all headers, line by line, from HTTP request and appends them to m_body.
-         * @param[in] request Data of HTTP request.
-         * @param[in] format_width Width of body for verbose formatting (log_type + date).
+         * Rotates output on request of SIGUSR1, called only by writer thread. Loggers without own output
+         * file have nothing to rotate.
          */
-        void append_request_headers(const string &request, const int &format_width) noexcept;
+        virtual void rotate_output() noexcept {}
         /**
-         * Extracts HTTP code from response data (example: "304 Not Modified").
-         * @param[in] response Data of HTTP response.
-         * @return String containing HTTP code of server response.
+         * Appends type of logged message to body.
+         * @param[in] type Type of logged message.
+         * @param[out] body Body of logged message, appended to given string.
          */
-        string extract_response_code(const string &response) noexcept;
+        void set_log_type(const log_types &type, string &body) noexcept;
         /**
-         * Extracts all headers, line by line, from HTTP response and appends them to m_body.
-         * @param[in] response Data of HTTP response.
+         * Appends headers, line by line, to body.
+         * @param[in] title Title of headers.
+         * @param[in] headers Headers as name and value.
          * @param[in] format_width Width of body for verbose formatting (log_type + date).
+         * @param[out] body Body of logged message, appended to given string.
          */
-        void append_response_headers(const string &response, const int &format_width) noexcept;
+        void append_headers(const string &title, const vector<pair<string, string>> &headers,
+                const size_t &format_width, string &body) noexcept;
         /**
-         * Gets current date, appends log header to m_body and in \ref Verbosity "verbose" mode
-         * appends all headers to m_body.
-         * @param[in] request %Request data received from client.
-         * @param[in] response %Response data sent by server.
-         * @param[in] ip IP of client.
-         * @see get_date()
-         * @see extract_request_status()
-         * @see append_request_headers()
-         * @see extract_response_code()
-         * @see append_response_headers()
+         * Appends record to body in \ref LogFormat "log_format" of logger.
+         * @param[in] record Logged record.
+         * @param[out] body Body of logged messages, appended to given string.
+         * @see construct_text_body()
+         * @see construct_json_body()
+         */
+        void construct_body(const log_record &record, string &body) noexcept;
+        /**
+         * Appends log line of record to body, followed by headers of HTTP record in \ref Verbosity "verbose" mode.
+         * @param[in] record Logged record.
+         * @param[out] body Body of logged messages, appended to given string.
+         * @see set_log_type()
+         * @see Clock::get_log_date()
+         */
+        void construct_text_body(const log_record &record, string &body) noexcept;
+        /**
+         * Appends record to body as one line holding JSON object, with headers of HTTP record in
+         * \ref Verbosity "verbose" mode.
+         * @param[in] record Logged record.
+         * @param[out] body Body of logged messages, appended to given string.
+         * @see Clock::get_iso_date()
+         */
+        void construct_json_body(const log_record &record, string &body) noexcept;
+        /**
+         * Appends value to body as JSON string, escaping quotes, backslashes and control characters.
+         * @param[in] value Value to be appended.
+         * @param[out] body Body of logged message, appended to given string.
+         */
+        static void append_json_string(const string_view &value, string &body) noexcept;
+        /**
+         * Appends headers to body as JSON object, with values of repeated headers joined by ", ".
+         * @param[in] headers Headers as name and value.
+         * @param[out] body Body of logged message, appended to given string.
+         */
+        static void append_json_headers(const vector<pair<string, string>> &headers, string &body) noexcept;
+    private:
+        /**
+         * Struct holding one slot of ring buffer.
+         */
+        struct slot {
+            /** Member holding position at which slot can be pushed (equal) or popped (one more). */
+            atomic<size_t> sequence;
+            /** Member holding record stored in slot. */
+            log_record record;
+        };
+        /** Static member holding maximal number of records written in one batch. */
+        static const size_t max_batch = 256;
+        /** Static member holding how long may HTTP records wait in ring buffer before they are written. */
+        static constexpr chrono::milliseconds flush_interval{100};
+        /**
+         * Struct holding rate limit window of one message type.
+         */
+        struct rate_window {
+            /** Member holding second of current window. */
+            atomic<time_t> second;
+            /** Member holding number of messages logged in current window. */
+            atomic<unsigned int> count;
+            /** Member holding number of suppressed messages not reported yet. */
+            atomic<size_t> suppressed;
+        };
+        /** Member holding rate limit windows indexed by log_types (HTTP is never rate limited). */
+        rate_window m_rate_windows[HTTP];
+        /** Member holding how many successful HTTP requests share one logged record (1 logs all). */
+        unsigned int m_sample;
+        /** Member holding time after which request is always logged (0 disables it). */
+        chrono::microseconds m_slow_time;
+        /** Member holding maximum number of messages of one type logged per second (0 disables limit). */
+        unsigned int m_rate_limit;
+        /** Member holding whether records are written as JSON lines instead of text. */
+        bool m_json;
+        /** Member holding whether full ring buffer blocks workers instead of dropping records. */
+        bool m_blocking;
+        /** Member holding ring buffer slots. */
+        unique_ptr<slot[]> m_slots;
+        /** Member holding mask of slot index (number of slots minus one). */
+        size_t m_mask;
+        /** Member holding mask of pushed position at which writer thread is woken (half of slots minus one). */
+        size_t m_wake_mask;
+        /** Member holding next position to be pushed, shared by all workers. */
+        alignas(64) atomic<size_t> m_push_position;
+        /** Member holding next position to be popped, used only by writer thread. */
+        alignas(64) size_t m_pop_position;
+        /** Member holding number of records dropped since last report. */
+        alignas(64) atomic<size_t> m_dropped;
+        /** Member holding whether writer thread waits for records. */
+        atomic<bool> m_writer_sleeping;
+        /** Member holding writer thread. */
+        thread m_writer;
+        /** Member guarding waking of writer thread. */
+        mutex m_writer_lock;
+        /** Member waking writer thread when records are pushed or logger is stopped. */
+        condition_variable m_writer_cv;
+        /** Member holding whether writer thread should stop. */
+        bool m_stop;
+        /**
+         * Pushes record into ring buffer and wakes writer thread if record should not wait. Full ring buffer drops
+         * record (counted in m_dropped), or waits for writer thread if logger is blocking.
+         * @param[in,out] record Record to be logged, moved into ring buffer.
+         */
+        void push_record(log_record &record) noexcept;
+        /**
+         * Tries to push record into ring buffer.
+         * @param[in,out] record Record to be logged, moved into ring buffer only if there is free slot.
+         * @param[out] position Position at which record was pushed.
+         * @return true if record was pushed, false if ring buffer is full.
+         */
+        bool try_push(log_record &record, size_t &position) noexcept;
+        /**
+         * Pops oldest record from ring buffer, called only by writer thread.
+         * @param[out] record Popped record.
+         * @return true if record was popped, false if ring buffer is empty.
+         */
+        bool try_pop(log_record &record) noexcept;
+        /**
+         * Checks if ring buffer has no record to be popped, called only by writer thread.
+         * @return true if ring buffer is empty, false otherwise.
+         */
+        bool is_empty() const noexcept;
+        /**
+         * Wakes writer thread if it waits for records.
+         */
+        void wake_writer() noexcept;
+        /**
+         * Checks if message of given type fits into rate limit of current second, counts it as suppressed otherwise.
+         * @param[in] type Type of logged message.
+         * @param[in] now Current second.
+         * @return true if message should be logged, false if it is suppressed.
+         */
+        bool is_within_rate(const log_types &type, const time_t &now) noexcept;
+        /**
+         * Appends warning records reporting messages suppressed in already finished seconds, called only by writer
+         * thread.
+         * @param[out] records Batch of records, appended to given vector.
+         * @param[in] is_final Whether logger is stopped, so messages suppressed in current second are reported too.
+         */
+        void report_suppressed(vector<log_record> &records, const bool &is_final) noexcept;
+        /**
+         * Runs in writer thread, writes batches of records until logger is stopped and ring buffer is empty.
+         * Reports number of dropped and suppressed records as warning. Waits at most flush_interval for records, so it notices
+         * rotate_requested in time.
          */
-        void construct_body(const string &request, const string &response, const string &ip) noexcept;
+        void run_writer() noexcept;
 };
 
 
@@ -6,13 +6,14 @@
 
 #include "SyslogLogger.h"
 
-SyslogLogger::SyslogLogger(const string &verbosity) {
-    m_verbosity = verbosity;
+SyslogLogger::SyslogLogger(const string &verbosity, const string &overflow, const size_t &buffer_size):
+    Logger(verbosity, "text", overflow, buffer_size) {
     if (m_verbosity == "none")
         return;
 
     openlog("Eirserver", LOG_PID, LOG_USER);
     log_message(WARNING, "Starting Eirserver!");
+    start_writer();
 
     return;
 }
@@ -22,47 +23,39 @@ SyslogLogger::~SyslogLogger() {
         return;
 
     log_message(WARNING, "Closing Eirserver!");
+    stop_writer();
     closelog();
 
     return;
 }
 
-void SyslogLogger::log_message(const log_types &type, const string &message) noexcept {
-    if (m_verbosity == "none")
-        return;
-
-    // Prepare m_body
-    set_log_type(type);
-    m_body = message;
+void SyslogLogger::write_records(const vector<log_record> &records) noexcept {
+    string body;
 
-    // Log m_body
-    syslog(m_type, "%s", m_body.c_str());
-
-    return;
-}
+    for (const auto &record : records) {
+        if (record.type != HTTP) {
+            syslog(get_priority(record.type), "%s", record.message.c_str());
+            continue;
+        }
 
-void SyslogLogger::log_http(const string &request, const string &response, const string &ip) noexcept {
-    if (m_verbosity == "none")
-        return;
-
-    // Prepare and log m_body
-    m_body = "HTTP: " + ip + " - \"" + extract_request_status(request) + "\" <- \"" + extract_response_code(response) + "\"\n";
-    syslog(m_type, "%s", m_body.c_str());
+        // Prepare and log HTTP body
+        body = "HTTP: " + record.ip + " - \"" + record.method + " " + record.path + " " + record.version + "\" <- \""
+                + record.status + "\" " + to_string(record.bytes) + " B " + to_string(record.duration) + " us";
+        syslog(get_priority(record.type), "%s", body.c_str());
+    }
 
     return;
 }
 
-void SyslogLogger::set_log_type(const log_types &type) noexcept {
+int SyslogLogger::get_priority(const log_types &type) const noexcept {
     switch (type) {
         case ERROR:
-            m_type = LOG_ERR;
-            break;
+            return LOG_ERR;
         case WARNING:
-            m_type = LOG_WARNING;
-            break;
+            return LOG_WARNING;
         case INFO:
-            m_type = LOG_INFO;
-            break;
+        case HTTP:
+            return LOG_INFO;
     }
-    return;
+    return LOG_INFO;
 }
@@ -13,37 +13,32 @@
 class SyslogLogger: public Logger {
     public:
         /**
-         * Sets logger verbosity (m_verbosity), opens syslog and logs start message.
+         * Calls Logger() with given verbosity and ring buffer settings (syslog is always written as text), opens
+         * syslog, logs start message and starts writer thread.
          * @param[in] verbosity Verbosity of logger.
+         * @param[in] overflow What happens when ring buffer is full ("drop" or "block").
+         * @param[in] buffer_size Number of records ring buffer can hold.
+         * @see Logger
          */
-        SyslogLogger(const string &verbosity);
+        SyslogLogger(const string &verbosity, const string &overflow, const size_t &buffer_size);
         /**
-         * Logs closing message and closes syslog.
+         * Logs closing message, stops writer thread once everything is written and closes syslog.
          */
         ~SyslogLogger();
+    protected:
         /**
-         * Gets current date and sets logged message type. Logs message to syslog.
-         * @param[in] type Type of logged message.
-         * @param[in] message Message text to be logged.
-         * @see set_log_type()
-         */
-        virtual void log_message(const log_types &type, const string &message) noexcept override;
-        /**
-         * Logs minimal HTTP request and response code to syslog. Ignores verbose mode (never includes HTTP headers).
-         * @param[in] request HTTP request data received from client.
-         * @param[in] response HTTP response data sent by server.
-         * @param[in] ip IP of client.
+         * Writes records to syslog one by one. Ignores verbose mode (never includes HTTP headers).
+         * @param[in] records Records in order in which they were pushed.
          */
-        virtual void log_http(const string &request, const string &response, const string &ip) noexcept override;
+        virtual void write_records(const vector<log_record> &records) noexcept override;
     private:
-        /** Member holding type of syslog message. */
-        int m_type;
         /**
-         * Sets syslog type of logged message.
+         * Gets syslog priority of logged message.
          * @param[in] type Type of logged message.
+         * @return Int representing syslog priority.
          * @see log_types
          */
-        virtual void set_log_type(const log_types &type) noexcept override;
+        int get_priority(const log_types &type) const noexcept;
 };
 
 
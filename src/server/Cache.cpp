@@ -5,64 +5,277 @@
 #include <iterator>
 #include <sys/stat.h>
 #include <functional>
+#include <algorithm>
 
 #include "Cache.h"
 
-Cache::cache_status Cache::check_file(const string &path, const string &etag) noexcept {
-    struct stat path_status;
-    time_t now = std::time(nullptr);
-    auto entries_itr = m_entries.find(path);
-
+Cache::Cache(const int &time, const size_t &max_entries):
+    m_time(time), m_shard_max_entries((max_entries + Cache::shard_count - 1) / Cache::shard_count),
+    m_tick_length(time / static_cast<time_t>(Cache::wheel_size - 2) + 1), m_stop(false) {
     // Disabled cache
     if (m_time == 0)
+        return;
+
+    // Nothing older than now can be swept
+    time_t tick = std::time(nullptr) / m_tick_length;
+    for (auto &entries_shard : m_shards)
+        entries_shard.swept_tick = tick;
+
+    m_sweeper = thread(&Cache::sweep, this);
+    return;
+}
+
+Cache::~Cache() {
+    {
+        lock_guard<mutex> lock(m_sweeper_lock);
+        m_stop = true;
+    }
+    m_sweeper_cv.notify_all();
+    if (m_sweeper.joinable())
+        m_sweeper.join();
+    return;
+}
+
+Cache::cache_status Cache::check_file(const string &path, const string &etag, const struct stat &status) noexcept {
+    time_t now = std::time(nullptr);
+
+    // Disabled cache or client does not have the file cached
+    if (m_time == 0 || etag.empty())
         return NOT_FOUND;
 
+    // Get hash of path, outside of shard lock
+    size_t path_hash = hash<string>{}(path);
+
+    struct shard &entries_shard = get_shard(path_hash);
+    lock_guard<mutex> lock(entries_shard.lock);
+    size_t index = find_slot(entries_shard, path_hash, path);
+
     // File not found in cache
-    if (entries_itr == m_entries.end())
+    if (index == Cache::npos)
         return NOT_FOUND;
+    struct file &entry = entries_shard.slots[index].entry;
 
     // Delete too old cache entry
-    if ((now - entries_itr->second.access) > m_time) {
-        m_entries.erase(entries_itr);
-        return NOT_FOUND;
+    if ((now - entry.access) > m_time) {
+        erase_slot(entries_shard, index);
+        return EXPIRED;
     }
 
-    // Get file info
-    if (stat(path.c_str(), &path_status) < 0)
-        return ERROR;
-
     // Found valid cache entry
-    if (entries_itr->second.last_mod == path_status.st_mtime && entries_itr->second.etag == etag) {
-        entries_itr->second.access = now;
+    if (entry.last_mod == status.st_mtime && entry.etag == etag) {
+        entry.access = now;
+        touch_slot(entries_shard, index);
         return OK;
     }
 
-    // File found but changed
-    m_entries.erase(entries_itr);
+    // File found but changed, unknown ETag of unchanged file does not invalidate entry
+    if (entry.last_mod != status.st_mtime) {
+        erase_slot(entries_shard, index);
+        return EXPIRED;
+    }
     return NOT_FOUND;
 }
 
-bool Cache::add_file(const string &path, string &etag) noexcept {
-    struct stat path_status;
+bool Cache::add_file(const string &path, string &etag, const struct stat &status) noexcept {
     time_t now = std::time(nullptr);
 
     // Disabled cache
     if (m_time == 0)
         return true;
 
-    // Get file info
-    if (stat(path.c_str(), &path_status) < 0)
-        return false;
-
     // Set etag of file and add it to cache
-    etag = path;
-    etag += to_string(path_status.st_mtime);
-    etag = "\"" + to_string(hash<string>{}(etag)) + "\"";
-    m_entries[path] = file(etag, path_status.st_mtime, now);
+    etag = get_etag(path, status);
+    size_t path_hash = hash<string>{}(path);
+    struct shard &entries_shard = get_shard(path_hash);
+    lock_guard<mutex> lock(entries_shard.lock);
+    if (m_shard_max_entries > 0 && entries_shard.count >= m_shard_max_entries
+            && find_slot(entries_shard, path_hash, path) == Cache::npos)
+        evict_oldest(entries_shard);
+    insert_slot(entries_shard, path_hash, path, file(etag, status.st_mtime, now));
+    touch_slot(entries_shard, find_slot(entries_shard, path_hash, path));
 
     return true;
 }
 
-int Cache::get_time() noexcept {
+string Cache::get_etag(const string &path, const struct stat &status) noexcept {
+    return "\"" + to_string(hash<string>{}(path + to_string(status.st_mtime))) + "\"";
+}
+
+int Cache::get_time() const noexcept {
     return m_time;
-}
\ No newline at end of file
+}
+
+struct Cache::shard& Cache::get_shard(const size_t &path_hash) noexcept {
+    return m_shards[path_hash % Cache::shard_count];
+}
+
+size_t Cache::get_home_slot(const struct shard &entries_shard, const size_t &path_hash) noexcept {
+    // Lowest bits of hash already chose shard
+    return (path_hash / Cache::shard_count) & (entries_shard.slots.size() - 1);
+}
+
+size_t Cache::find_slot(const struct shard &entries_shard, const size_t &path_hash, const string &path) noexcept {
+    size_t mask = entries_shard.slots.size() - 1;
+
+    if (entries_shard.slots.empty())
+        return Cache::npos;
+
+    // Probe until empty slot, table is never full
+    for (size_t index = get_home_slot(entries_shard, path_hash); entries_shard.slots[index].used;
+            index = (index + 1) & mask) {
+        if (entries_shard.slots[index].path_hash == path_hash && entries_shard.slots[index].path == path)
+            return index;
+    }
+
+    return Cache::npos;
+}
+
+void Cache::insert_slot(struct shard &entries_shard, const size_t &path_hash, const string &path,
+        const struct file &entry) {
+    // Replace existing entry
+    size_t index = find_slot(entries_shard, path_hash, path);
+    if (index != Cache::npos) {
+        struct file &old_entry = entries_shard.slots[index].entry;
+        time_t tick = old_entry.tick;
+        size_t wheel_pos = old_entry.wheel_pos;
+        old_entry = entry;
+        old_entry.tick = tick;
+        old_entry.wheel_pos = wheel_pos;
+        return;
+    }
+
+    // Keep table at most 3/4 full, so probe sequences stay short
+    if ((entries_shard.count + 1) * 4 > entries_shard.slots.size() * 3) {
+        vector<struct slot> old_slots(max(entries_shard.slots.size() * 2, Cache::initial_slots));
+        old_slots.swap(entries_shard.slots);
+        entries_shard.count = 0;
+        for (auto &old_slot : old_slots)
+            if (old_slot.used)
+                insert_slot(entries_shard, old_slot.path_hash, old_slot.path, old_slot.entry);
+    }
+
+    // Use first empty slot of probe sequence
+    size_t mask = entries_shard.slots.size() - 1;
+    for (index = get_home_slot(entries_shard, path_hash); entries_shard.slots[index].used; index = (index + 1) & mask);
+    entries_shard.slots[index].used = true;
+    entries_shard.slots[index].path_hash = path_hash;
+    entries_shard.slots[index].path = path;
+    entries_shard.slots[index].entry = entry;
+    entries_shard.count++;
+
+    return;
+}
+
+void Cache::erase_slot(struct shard &entries_shard, size_t index) noexcept {
+    size_t mask = entries_shard.slots.size() - 1, home = 0;
+
+    unlink_slot(entries_shard, index);
+
+    // Move following entries back to the hole if their probe sequence passes through it
+    for (size_t next = (index + 1) & mask; entries_shard.slots[next].used; next = (next + 1) & mask) {
+        home = get_home_slot(entries_shard, entries_shard.slots[next].path_hash);
+        if (((next - home) & mask) >= ((next - index) & mask)) {
+            entries_shard.slots[index] = move(entries_shard.slots[next]);
+            index = next;
+        }
+    }
+
+    entries_shard.slots[index].used = false;
+    entries_shard.slots[index].path.clear();
+    entries_shard.count--;
+
+    return;
+}
+
+void Cache::unlink_slot(struct shard &entries_shard, const size_t &index) noexcept {
+    struct file &entry = entries_shard.slots[index].entry;
+    if (entry.wheel_pos == Cache::npos)
+        return;
+
+    // Move last entry of bucket to the freed position
+    vector<struct wheel_key> &bucket = entries_shard.wheel[entry.tick % Cache::wheel_size];
+    if (entry.wheel_pos != bucket.size() - 1) {
+        bucket[entry.wheel_pos] = move(bucket.back());
+        size_t moved = find_slot(entries_shard, bucket[entry.wheel_pos].path_hash, bucket[entry.wheel_pos].path);
+        entries_shard.slots[moved].entry.wheel_pos = entry.wheel_pos;
+    }
+    bucket.pop_back();
+    entry.wheel_pos = Cache::npos;
+
+    return;
+}
+
+void Cache::touch_slot(struct shard &entries_shard, const size_t &index) {
+    struct slot &entry_slot = entries_shard.slots[index];
+    time_t tick = entry_slot.entry.access / m_tick_length;
+
+    // Entry is already registered in bucket of its access time
+    if (entry_slot.entry.wheel_pos != Cache::npos && entry_slot.entry.tick == tick)
+        return;
+
+    unlink_slot(entries_shard, index);
+    vector<struct wheel_key> &bucket = entries_shard.wheel[tick % Cache::wheel_size];
+    bucket.push_back({entry_slot.path_hash, entry_slot.path});
+    entry_slot.entry.tick = tick;
+    entry_slot.entry.wheel_pos = bucket.size() - 1;
+
+    return;
+}
+
+void Cache::evict_oldest(struct shard &entries_shard) noexcept {
+    time_t now_tick = std::time(nullptr) / m_tick_length;
+
+    // Go through buckets from the oldest one, bucket may also hold newer entries after wheel turned around
+    for (time_t tick = entries_shard.swept_tick; tick <= now_tick; ++tick) {
+        for (const auto &key : entries_shard.wheel[tick % Cache::wheel_size]) {
+            size_t index = find_slot(entries_shard, key.path_hash, key.path);
+            if (entries_shard.slots[index].entry.tick <= tick) {
+                erase_slot(entries_shard, index);
+                return;
+            }
+        }
+    }
+
+    return;
+}
+
+void Cache::sweep() noexcept {
+    unique_lock<mutex> lock(m_sweeper_lock);
+
+    while (!m_sweeper_cv.wait_for(lock, chrono::seconds(1), [this] { return m_stop; })) {
+        time_t now = std::time(nullptr);
+        for (auto &entries_shard : m_shards)
+            sweep_shard(entries_shard, now);
+    }
+
+    return;
+}
+
+void Cache::sweep_shard(struct shard &entries_shard, const time_t &now) noexcept {
+    size_t index = 0, i = 0, swept = 0;
+    unique_lock<mutex> lock(entries_shard.lock);
+
+    // Every entry accessed during swept tick is expired
+    while ((entries_shard.swept_tick + 1) * m_tick_length + m_time <= now) {
+        vector<struct wheel_key> &bucket = entries_shard.wheel[entries_shard.swept_tick % Cache::wheel_size];
+        i = 0;
+        while (i < bucket.size()) {
+            index = find_slot(entries_shard, bucket[i].path_hash, bucket[i].path);
+            // Newer entry sharing the same bucket after wheel turned around
+            if ((now - entries_shard.slots[index].entry.access) <= m_time) {
+                i++;
+                continue;
+            }
+            // Last entry of bucket takes place of erased one
+            erase_slot(entries_shard, index);
+            // Let workers in
+            if (++swept % Cache::sweep_batch == 0) {
+                lock.unlock();
+                lock.lock();
+            }
+        }
+        entries_shard.swept_tick++;
+    }
+
+    return;
+}
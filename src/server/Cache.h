@@ -5,28 +5,48 @@
 #ifndef EIRSERVER_CACHE_H
 #define EIRSERVER_CACHE_H
 
-#include <map>
+#include <vector>
+#include <array>
+#include <mutex>
 #include <string>
 #include <ctime>
+#include <thread>
+#include <condition_variable>
+#include <sys/stat.h>
 
 using namespace std;
 
 /**
  * Class storing and checking cache entries.
+ * @note Cache is shared by all workers, so entries are split into shards by hash of their path, each
+ * guarded by its own mutex. Workers checking different files therefore almost never wait for each other.
+ * @note Every shard is open addressing hash table with linear probing. Hash of path is computed once per call
+ * and stored in entry, so lookup compares whole paths only for entries with equal hash.
+ * @note Expired entries are removed by background sweeper thread. Every shard has timing wheel with buckets
+ * of entries by their last access time, so sweeper visits only buckets which already expired and never scans
+ * whole cache. Number of entries is capped by \ref CacheMaxEntries "cache_max_entries", so cache does not grow
+ * with number of distinct requested paths.
  */
 class Cache {
     public:
         /**
-         * Sets cache time value (m_time).
+         * Sets cache time value (m_time), maximum number of entries in one shard (m_shard_max_entries) and
+         * starts sweeper thread (m_sweeper) if cache is enabled.
          * @param[in] time %Cache time value.
+         * @param[in] max_entries Maximum number of cache entries (0 means unlimited).
          */
-        Cache(const int &time): m_time(time) {}
+        Cache(const int &time, const size_t &max_entries);
+        /**
+         * Stops sweeper thread.
+         */
+        ~Cache();
         /**
          * Member holding cache status responses
          */
         enum cache_status {
             OK,
             NOT_FOUND,
+            EXPIRED,
             ERROR
         };
         /**
@@ -34,23 +54,34 @@ class Cache {
          * resets its age in cache.
          * @param[in] path %Path of checked cache entry.
          * @param[in] etag ETag value of checked cache entry.
-         * @return ERROR if stat() encountered error, OK if file found in cache, NOT_FOUND if file not found in cache
-         * or was modified.
+         * @param[in] status Status of checked file, read once when it was opened.
+         * @return OK if file found in cache, NOT_FOUND if file not found in cache, EXPIRED if its entry was too old
+         * or file was modified.
          */
-        cache_status check_file(const string &path, const string &etag) noexcept;
+        cache_status check_file(const string &path, const string &etag, const struct stat &status) noexcept;
         /**
-         * Adds file to cache.
+         * Adds file to cache. If shard of file is full, evicts its least recently accessed entry first.
          * @param[in] path %Path to file added to cache
          * @param[out] etag ETag value of file added to cache.
+         * @param[in] status Status of added file, read once when it was opened.
          * @return true if file added to cache or cache disabled, false otherwise
          */
-        bool add_file(const string &path, string &etag) noexcept;
+        bool add_file(const string &path, string &etag, const struct stat &status) noexcept;
+        /**
+         * Computes ETag value of file from its path and last modification time.
+         * @param[in] path %Path to file.
+         * @param[in] status Status of file.
+         * @return String containing quoted ETag value.
+         */
+        static string get_etag(const string &path, const struct stat &status) noexcept;
         /**
          * Gets cache time value (m_time).
          * @return Int representing cache time value.
          */
-        int get_time() noexcept;
+        int get_time() const noexcept;
     private:
+        /** Stress test checks consistency of shards after workers and sweeper used them. */
+        friend class CacheStressTest;
         /**
          * Struct storing information about cache entries.
          */
@@ -72,11 +103,147 @@ class Cache {
             time_t last_mod;
             /** Member containing last cache access time of cache entry. */
             time_t access;
+            /** Member containing timing wheel tick in which entry is registered. */
+            time_t tick = 0;
+            /** Member containing position of entry in its timing wheel bucket (npos if not registered). */
+            size_t wheel_pos = Cache::npos;
+        };
+        /**
+         * Struct storing one slot of shard hash table.
+         */
+        struct slot {
+            /** Member holding whether slot contains cache entry. */
+            bool used = false;
+            /** Member holding precomputed hash of path. */
+            size_t path_hash = 0;
+            /** Member holding path of cache entry. */
+            string path;
+            /** Member holding cache entry. */
+            struct file entry;
+        };
+        /**
+         * Struct storing reference to cache entry in timing wheel.
+         */
+        struct wheel_key {
+            /** Member holding precomputed hash of path. */
+            size_t path_hash;
+            /** Member holding path of cache entry. */
+            string path;
         };
-        /** Member map storing all cache entries. */
-        map<string, struct file> m_entries;
+        /** Static member holding number of timing wheel buckets. */
+        static constexpr size_t wheel_size = 64;
+        /**
+         * Struct storing one part of cache entries.
+         */
+        struct shard {
+            /** Member guarding entries of shard. */
+            mutex lock;
+            /** Member vector holding slots of hash table, its size is always power of two. */
+            vector<struct slot> slots;
+            /** Member holding number of used slots. */
+            size_t count = 0;
+            /**
+             * Member array holding timing wheel, bucket tick % wheel_size holds entries last accessed in tick.
+             * @note Every entry is registered in exactly one bucket and remembers its position there, so it can
+             * be moved to newer bucket on access in constant time.
+             */
+            array<vector<struct wheel_key>, wheel_size> wheel;
+            /** Member holding oldest timing wheel tick which was not swept yet. */
+            time_t swept_tick = 0;
+        };
+        /** Static member holding number of cache shards. */
+        static const size_t shard_count = 16;
+        /** Static member holding how many wheel entries are swept before shard lock is released for a while. */
+        static const size_t sweep_batch = 128;
+        /** Static member holding initial number of slots in shard hash table. */
+        static constexpr size_t initial_slots = 64;
+        /** Member array storing all cache entries split into shards. */
+        array<struct shard, shard_count> m_shards;
         /** Member holding cache time value (for how long should files be kept in cache). */
         int m_time;
+        /** Member holding maximum number of entries in one shard (0 means unlimited). */
+        size_t m_shard_max_entries;
+        /** Member holding length of one timing wheel tick in seconds. */
+        time_t m_tick_length;
+        /** Member holding sweeper thread. */
+        thread m_sweeper;
+        /** Member guarding m_stop. */
+        mutex m_sweeper_lock;
+        /** Member waking sweeper thread when cache is destroyed. */
+        condition_variable m_sweeper_cv;
+        /** Member holding whether sweeper thread should stop. */
+        bool m_stop;
+        /**
+         * Gets shard in which cache entry for given path hash belongs.
+         * @param[in] path_hash Hash of path of cache entry.
+         * @return Reference to shard of cache entry.
+         */
+        struct shard& get_shard(const size_t &path_hash) noexcept;
+        /**
+         * Gets slot of shard hash table where probing for given path hash starts.
+         * @param[in] entries_shard Shard of cache entry.
+         * @param[in] path_hash Hash of path of cache entry.
+         * @return Index of first probed slot.
+         */
+        static size_t get_home_slot(const struct shard &entries_shard, const size_t &path_hash) noexcept;
+        /**
+         * Searches shard hash table for cache entry. Shard has to be locked.
+         * @param[in] entries_shard Shard of cache entry.
+         * @param[in] path_hash Hash of path of cache entry.
+         * @param[in] path %Path of cache entry.
+         * @return Index of slot with cache entry or npos if entry is not in shard.
+         */
+        static size_t find_slot(const struct shard &entries_shard, const size_t &path_hash, const string &path) noexcept;
+        /**
+         * Inserts or replaces cache entry in shard hash table, grows table if it is too full. Replaced entry keeps
+         * its place in timing wheel. Shard has to be locked.
+         * @param[in] entries_shard Shard of cache entry.
+         * @param[in] path_hash Hash of path of cache entry.
+         * @param[in] path %Path of cache entry.
+         * @param[in] entry Cache entry.
+         */
+        static void insert_slot(struct shard &entries_shard, const size_t &path_hash, const string &path,
+                const struct file &entry);
+        /**
+         * Removes cache entry from timing wheel and shard hash table and shifts following entries of its probe
+         * sequence back, so no tombstones are needed. Shard has to be locked.
+         * @param[in] entries_shard Shard of cache entry.
+         * @param[in] index Index of slot with cache entry.
+         */
+        static void erase_slot(struct shard &entries_shard, size_t index) noexcept;
+        /**
+         * Removes cache entry from its timing wheel bucket. Last entry of bucket takes its place.
+         * Shard has to be locked.
+         * @param[in] entries_shard Shard of cache entry.
+         * @param[in] index Index of slot with cache entry.
+         */
+        static void unlink_slot(struct shard &entries_shard, const size_t &index) noexcept;
+        /**
+         * Registers cache entry in timing wheel bucket of its last access time, unless it is already there.
+         * Shard has to be locked.
+         * @param[in] entries_shard Shard of cache entry.
+         * @param[in] index Index of slot with cache entry.
+         */
+        void touch_slot(struct shard &entries_shard, const size_t &index);
+        /**
+         * Removes least recently accessed entry from shard. Shard has to be locked.
+         * @param[in] entries_shard Shard of cache entry.
+         */
+        void evict_oldest(struct shard &entries_shard) noexcept;
+        /**
+         * Runs in sweeper thread, once per second sweeps all shards until cache is destroyed.
+         * @see sweep_shard()
+         */
+        void sweep() noexcept;
+        /**
+         * Removes expired entries from all timing wheel buckets of shard whose whole tick already expired.
+         * Releases shard lock after every sweep_batch entries, so workers are never blocked for long.
+         * @param[in] entries_shard Swept shard.
+         * @param[in] now Current time.
+         */
+        void sweep_shard(struct shard &entries_shard, const time_t &now) noexcept;
+        /** Static member returned by find_slot() if entry is not found. */
+        static constexpr size_t npos = static_cast<size_t>(-1);
 };
 
 
@@ -0,0 +1,44 @@
+//
+// Created by satopja2 on 17.10.26.
+//
+
+#include "Clock.h"
+
+const string& Clock::get_http_date() noexcept {
+    thread_local struct formatted_date http_date;
+    return format_date(http_date, time(nullptr), "%a, %d %b %Y %T GMT", false);
+}
+
+const string& Clock::get_log_date() noexcept {
+    return get_log_date(time(nullptr));
+}
+
+const string& Clock::get_log_date(const time_t &second) noexcept {
+    thread_local struct formatted_date log_date;
+    return format_date(log_date, second, "%d.%m.%Y %T", true);
+}
+
+const string& Clock::get_iso_date(const time_t &second) noexcept {
+    thread_local struct formatted_date iso_date;
+    return format_date(iso_date, second, "%Y-%m-%dT%T%z", true);
+}
+
+const string& Clock::format_date(struct formatted_date &cached, const time_t &second, const char *format,
+        const bool &is_local) noexcept {
+    char date_c_str[64];
+    struct tm time_parts;
+
+    // Date is still valid in the same second
+    if (second == cached.second)
+        return cached.date;
+
+    if (is_local)
+        localtime_r(&second, &time_parts);
+    else
+        gmtime_r(&second, &time_parts);
+    strftime(date_c_str, sizeof(date_c_str), format, &time_parts);
+    cached.date = date_c_str;
+    cached.second = second;
+
+    return cached.date;
+}
@@ -0,0 +1,69 @@
+//
+// Created by satopja2 on 17.10.26.
+//
+
+#ifndef EIRSERVER_CLOCK_H
+#define EIRSERVER_CLOCK_H
+
+#include <string>
+#include <ctime>
+
+using namespace std;
+
+/**
+ * Class providing current date formatted for HTTP responses and logs.
+ * @note Every thread keeps its own formatted dates and formats them again only once the second changes, so
+ * dates are shared by all requests handled in the same second without any locking.
+ */
+class Clock {
+    public:
+        /**
+         * Gets current date for HTTP Date header.
+         * @return Reference to string containing current date in format "%a, %d %b %Y %T GMT", valid until
+         * this thread calls get_http_date() again.
+         */
+        static const string& get_http_date() noexcept;
+        /**
+         * Gets current local date for log messages.
+         * @return Reference to string containing current date in format "%d.%m.%Y %T", valid until this thread
+         * calls get_log_date() again.
+         */
+        static const string& get_log_date() noexcept;
+        /**
+         * Gets local date of given second for log messages.
+         * @param[in] second Second since epoch to be formatted.
+         * @return Reference to string containing date in format "%d.%m.%Y %T", valid until this thread calls
+         * get_log_date() again.
+         */
+        static const string& get_log_date(const time_t &second) noexcept;
+        /**
+         * Gets local date of given second in ISO 8601 format for structured log messages.
+         * @param[in] second Second since epoch to be formatted.
+         * @return Reference to string containing date in format "%Y-%m-%dT%T%z", valid until this thread calls
+         * get_iso_date() again.
+         */
+        static const string& get_iso_date(const time_t &second) noexcept;
+    private:
+        /**
+         * Struct holding date formatted in one second.
+         */
+        struct formatted_date {
+            /** Member holding second in which date was formatted (-1 if it was not formatted yet). */
+            time_t second = -1;
+            /** Member holding formatted date. */
+            string date;
+        };
+        /**
+         * Formats date again if it is not in the second in which it was formatted.
+         * @param[in,out] cached Date formatted earlier by this thread.
+         * @param[in] second Second since epoch to be formatted.
+         * @param[in] format Format of date for strftime().
+         * @param[in] is_local Whether date is in local time zone instead of GMT.
+         * @return Reference to formatted date in cached.
+         */
+        static const string& format_date(struct formatted_date &cached, const time_t &second, const char *format,
+                const bool &is_local) noexcept;
+};
+
+
+#endif //EIRSERVER_CLOCK_H
@@ -40,10 +40,38 @@ void Config::set_default_settings() {
             {"ip", "0.0.0.0"},
             {"port", "8080"},
             {"cache_time", "3600"},
+            {"cache_max_entries", "100000"},
             {"verbosity", "minimal"},
             {"log_type", "console"},
             {"log_file", ""},
             {"off_address", "/shutdown"},
+            {"workers", "1"},
+            {"keepalive_timeout", "5"},
+            {"keepalive_max_requests", "100"},
+            {"max_header_size", "8192"},
+            {"header_timeout", "10"},
+            {"send_timeout", "30"},
+            {"content_cache_size", "67108864"},
+            {"metadata_cache", "off"},
+            {"fd_cache_size", "256"},
+            {"precompressed", "on"},
+            {"compression_level", "6"},
+            {"compression_min_size", "1024"},
+            {"compression_types", "text/html,text/css,text/plain,text/javascript,application/javascript,"
+                    "application/json,application/xml,text/xml,image/svg+xml"},
+            {"compression_cache_size", "16777216"},
+            {"response_cache_size", "8388608"},
+            {"response_cache_max_file_size", "4096"},
+            {"log_overflow", "drop"},
+            {"log_format", "text"},
+            {"log_max_size", "0"},
+            {"log_keep", "5"},
+            {"log_compress", "off"},
+            {"log_sample", "1"},
+            {"log_slow_time", "1000"},
+            {"log_rate_limit", "100"},
+            {"log_buffer_size", "8192"},
+            {"metrics_address", ""},
     };
     m_settings["root_dir"] = get_current_directory();
     return;
@@ -97,10 +125,37 @@ void Config::check_config() const {
         check_port(find_setting_val("port"));
         check_root_dir(find_setting_val("root_dir"));
         check_cache_time(find_setting_val("cache_time"));
+        check_cache_max_entries(find_setting_val("cache_max_entries"));
         check_verbosity(find_setting_val("verbosity"));
         check_log_type(find_setting_val("log_type"));
         check_log_file(find_setting_val("log_file"), find_setting_val("log_type"));
         check_off_address(find_setting_val("off_address"));
+        check_workers(find_setting_val("workers"));
+        check_keepalive_timeout(find_setting_val("keepalive_timeout"));
+        check_keepalive_max_requests(find_setting_val("keepalive_max_requests"));
+        check_max_header_size(find_setting_val("max_header_size"));
+        check_header_timeout(find_setting_val("header_timeout"));
+        check_send_timeout(find_setting_val("send_timeout"));
+        check_content_cache_size(find_setting_val("content_cache_size"));
+        check_metadata_cache(find_setting_val("metadata_cache"));
+        check_fd_cache_size(find_setting_val("fd_cache_size"));
+        check_precompressed(find_setting_val("precompressed"));
+        check_compression_level(find_setting_val("compression_level"));
+        check_compression_min_size(find_setting_val("compression_min_size"));
+        check_compression_types(find_setting_val("compression_types"));
+        check_compression_cache_size(find_setting_val("compression_cache_size"));
+        check_response_cache_size(find_setting_val("response_cache_size"));
+        check_response_cache_max_file_size(find_setting_val("response_cache_max_file_size"));
+        check_log_overflow(find_setting_val("log_overflow"));
+        check_log_buffer_size(find_setting_val("log_buffer_size"));
+        check_log_format(find_setting_val("log_format"));
+        check_log_max_size(find_setting_val("log_max_size"));
+        check_log_keep(find_setting_val("log_keep"));
+        check_log_compress(find_setting_val("log_compress"));
+        check_log_sample(find_setting_val("log_sample"));
+        check_log_slow_time(find_setting_val("log_slow_time"));
+        check_log_rate_limit(find_setting_val("log_rate_limit"));
+        check_metrics_address(find_setting_val("metrics_address"));
     } catch (const runtime_error& e) {
         throw runtime_error(e.what());
     }
@@ -166,18 +221,272 @@ void Config::check_off_address(const string &off_address) const {
     return;
 }
 
+void Config::check_workers(const string &workers) const {
+    try {
+        int workers_number = stoi(workers);
+        if (workers_number < 0)
+            throw runtime_error("workers has to be >= 0");
+    } catch (const logic_error& e) {
+        throw runtime_error("workers is invalid");
+    }
+    return;
+}
+
+void Config::check_keepalive_timeout(const string &keepalive_timeout) const {
+    try {
+        int keepalive_timeout_number = stoi(keepalive_timeout);
+        if (keepalive_timeout_number < 0)
+            throw runtime_error("keepalive_timeout has to be >= 0");
+    } catch (const logic_error& e) {
+        throw runtime_error("keepalive_timeout is invalid");
+    }
+    return;
+}
+
+void Config::check_keepalive_max_requests(const string &keepalive_max_requests) const {
+    try {
+        int keepalive_max_requests_number = stoi(keepalive_max_requests);
+        if (keepalive_max_requests_number < 0)
+            throw runtime_error("keepalive_max_requests has to be >= 0");
+    } catch (const logic_error& e) {
+        throw runtime_error("keepalive_max_requests is invalid");
+    }
+    return;
+}
+
+void Config::check_max_header_size(const string &max_header_size) const {
+    try {
+        int max_header_size_number = stoi(max_header_size);
+        if (max_header_size_number < 256)
+            throw runtime_error("max_header_size has to be >= 256");
+    } catch (const logic_error& e) {
+        throw runtime_error("max_header_size is invalid");
+    }
+    return;
+}
+
+void Config::check_header_timeout(const string &header_timeout) const {
+    try {
+        int header_timeout_number = stoi(header_timeout);
+        if (header_timeout_number <= 0)
+            throw runtime_error("header_timeout has to be > 0");
+    } catch (const logic_error& e) {
+        throw runtime_error("header_timeout is invalid");
+    }
+    return;
+}
+
+void Config::check_send_timeout(const string &send_timeout) const {
+    try {
+        int send_timeout_number = stoi(send_timeout);
+        if (send_timeout_number <= 0)
+            throw runtime_error("send_timeout has to be > 0");
+    } catch (const logic_error& e) {
+        throw runtime_error("send_timeout is invalid");
+    }
+    return;
+}
+
+void Config::check_content_cache_size(const string &content_cache_size) const {
+    try {
+        long long content_cache_size_number = stoll(content_cache_size);
+        if (content_cache_size_number < 0)
+            throw runtime_error("content_cache_size has to be >= 0");
+    } catch (const logic_error& e) {
+        throw runtime_error("content_cache_size is invalid");
+    }
+    return;
+}
+
+void Config::check_cache_max_entries(const string &cache_max_entries) const {
+    try {
+        long long cache_max_entries_number = stoll(cache_max_entries);
+        if (cache_max_entries_number < 0)
+            throw runtime_error("cache_max_entries has to be >= 0");
+    } catch (const logic_error& e) {
+        throw runtime_error("cache_max_entries is invalid");
+    }
+    return;
+}
+
+void Config::check_metadata_cache(const string &metadata_cache) const {
+    if (metadata_cache != "on" && metadata_cache != "off")
+        throw runtime_error("metadata_cache option is invalid");
+    return;
+}
+
+void Config::check_fd_cache_size(const string &fd_cache_size) const {
+    try {
+        long long fd_cache_size_number = stoll(fd_cache_size);
+        if (fd_cache_size_number < 0)
+            throw runtime_error("fd_cache_size has to be >= 0");
+    } catch (const logic_error& e) {
+        throw runtime_error("fd_cache_size is invalid");
+    }
+    return;
+}
+
+void Config::check_precompressed(const string &precompressed) const {
+    if (precompressed != "on" && precompressed != "off")
+        throw runtime_error("precompressed option is invalid");
+    return;
+}
+
+void Config::check_compression_level(const string &compression_level) const {
+    try {
+        long long compression_level_number = stoll(compression_level);
+        if (compression_level_number < 0 || compression_level_number > 9)
+            throw runtime_error("compression_level has to be >= 0 and <= 9");
+    } catch (const logic_error& e) {
+        throw runtime_error("compression_level is invalid");
+    }
+    return;
+}
 
+void Config::check_compression_min_size(const string &compression_min_size) const {
+    try {
+        long long compression_min_size_number = stoll(compression_min_size);
+        if (compression_min_size_number < 0)
+            throw runtime_error("compression_min_size has to be >= 0");
+    } catch (const logic_error& e) {
+        throw runtime_error("compression_min_size is invalid");
+    }
+    return;
+}
 
+void Config::check_compression_types(const string &compression_types) const {
+    // Comma separated list of mime types, type may end with '*' (for example text/*)
+    for (size_t start = 0, end = 0; start <= compression_types.length(); start = end + 1) {
+        end = compression_types.find(',', start);
+        if (end == string::npos)
+            end = compression_types.length();
+        string type = compression_types.substr(start, end - start);
+        size_t slash = type.find('/');
+        if (slash == string::npos || slash == 0 || slash + 1 == type.length())
+            throw runtime_error("compression_types option is invalid");
+    }
+    return;
+}
 
+void Config::check_compression_cache_size(const string &compression_cache_size) const {
+    try {
+        long long compression_cache_size_number = stoll(compression_cache_size);
+        if (compression_cache_size_number < 0)
+            throw runtime_error("compression_cache_size has to be >= 0");
+    } catch (const logic_error& e) {
+        throw runtime_error("compression_cache_size is invalid");
+    }
+    return;
+}
 
+void Config::check_response_cache_size(const string &response_cache_size) const {
+    try {
+        long long response_cache_size_number = stoll(response_cache_size);
+        if (response_cache_size_number < 0)
+            throw runtime_error("response_cache_size has to be >= 0");
+    } catch (const logic_error& e) {
+        throw runtime_error("response_cache_size is invalid");
+    }
+    return;
+}
 
+void Config::check_response_cache_max_file_size(const string &response_cache_max_file_size) const {
+    try {
+        long long response_cache_max_file_size_number = stoll(response_cache_max_file_size);
+        if (response_cache_max_file_size_number < 0)
+            throw runtime_error("response_cache_max_file_size has to be >= 0");
+    } catch (const logic_error& e) {
+        throw runtime_error("response_cache_max_file_size is invalid");
+    }
+    return;
+}
 
+void Config::check_log_overflow(const string &log_overflow) const {
+    if (log_overflow != "drop" && log_overflow != "block")
+        throw runtime_error("log_overflow option is invalid");
+    return;
+}
 
+void Config::check_log_buffer_size(const string &log_buffer_size) const {
+    try {
+        long long log_buffer_size_number = stoll(log_buffer_size);
+        if (log_buffer_size_number < 1 || log_buffer_size_number > 1048576)
+            throw runtime_error("log_buffer_size has to be between 1 and 1048576");
+    } catch (const logic_error& e) {
+        throw runtime_error("log_buffer_size is invalid");
+    }
+    return;
+}
 
+void Config::check_log_format(const string &log_format) const {
+    if (log_format != "text" && log_format != "json")
+        throw runtime_error("log_format option is invalid");
+    return;
+}
 
+void Config::check_log_max_size(const string &log_max_size) const {
+    try {
+        long long log_max_size_number = stoll(log_max_size);
+        if (log_max_size_number < 0)
+            throw runtime_error("log_max_size has to be >= 0");
+    } catch (const logic_error& e) {
+        throw runtime_error("log_max_size is invalid");
+    }
+    return;
+}
 
+void Config::check_log_keep(const string &log_keep) const {
+    try {
+        int log_keep_number = stoi(log_keep);
+        if (log_keep_number < 0 || log_keep_number > 1000)
+            throw runtime_error("log_keep has to be between 0 and 1000");
+    } catch (const logic_error& e) {
+        throw runtime_error("log_keep is invalid");
+    }
+    return;
+}
 
+void Config::check_log_compress(const string &log_compress) const {
+    if (log_compress != "on" && log_compress != "off")
+        throw runtime_error("log_compress option is invalid");
+    return;
+}
 
+void Config::check_log_sample(const string &log_sample) const {
+    try {
+        int log_sample_number = stoi(log_sample);
+        if (log_sample_number < 1)
+            throw runtime_error("log_sample has to be >= 1");
+    } catch (const logic_error& e) {
+        throw runtime_error("log_sample is invalid");
+    }
+    return;
+}
 
+void Config::check_log_slow_time(const string &log_slow_time) const {
+    try {
+        int log_slow_time_number = stoi(log_slow_time);
+        if (log_slow_time_number < 0)
+            throw runtime_error("log_slow_time has to be >= 0");
+    } catch (const logic_error& e) {
+        throw runtime_error("log_slow_time is invalid");
+    }
+    return;
+}
 
+void Config::check_log_rate_limit(const string &log_rate_limit) const {
+    try {
+        int log_rate_limit_number = stoi(log_rate_limit);
+        if (log_rate_limit_number < 0)
+            throw runtime_error("log_rate_limit has to be >= 0");
+    } catch (const logic_error& e) {
+        throw runtime_error("log_rate_limit is invalid");
+    }
+    return;
+}
 
+void Config::check_metrics_address(const string &metrics_address) const {
+    if (!metrics_address.empty() && metrics_address.front() != '/')
+        throw runtime_error("metrics_address has to start with '/'");
+    return;
+}
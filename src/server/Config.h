@@ -80,6 +80,13 @@ class Config {
          * @see \ref CacheTime "cache_time"
          */
         void check_cache_time(const string &cache_time) const;
+        /**
+         * Checks if cache_max_entries is non-negative value.
+         * @param[in] cache_max_entries cache_max_entries value from config file.
+         * @throw runtime_error If cache_max_entries is not valid.
+         * @see \ref CacheMaxEntries "cache_max_entries"
+         */
+        void check_cache_max_entries(const string &cache_max_entries) const;
         /**
          * Checks if verbosity is valid choice.
          * @param[in] verbosity verbosity value from config file.
@@ -109,6 +116,188 @@ class Config {
          * @see \ref Shutdown "off_adress"
          */
         void check_off_address(const string &off_address) const;
+        /**
+         * Checks if workers is not negative value.
+         * @param[in] workers workers value from config file.
+         * @throw runtime_error If workers is not valid.
+         * @see \ref Workers "workers"
+         */
+        void check_workers(const string &workers) const;
+        /**
+         * Checks if keepalive_timeout is not negative value.
+         * @param[in] keepalive_timeout keepalive_timeout value from config file.
+         * @throw runtime_error If keepalive_timeout is not valid.
+         * @see \ref KeepaliveTimeout "keepalive_timeout"
+         */
+        void check_keepalive_timeout(const string &keepalive_timeout) const;
+        /**
+         * Checks if keepalive_max_requests is not negative value.
+         * @param[in] keepalive_max_requests keepalive_max_requests value from config file.
+         * @throw runtime_error If keepalive_max_requests is not valid.
+         * @see \ref KeepaliveMaxRequests "keepalive_max_requests"
+         */
+        void check_keepalive_max_requests(const string &keepalive_max_requests) const;
+        /**
+         * Checks if max_header_size is at least 256 bytes.
+         * @param[in] max_header_size max_header_size value from config file.
+         * @throw runtime_error If max_header_size is not valid.
+         * @see \ref MaxHeaderSize "max_header_size"
+         */
+        void check_max_header_size(const string &max_header_size) const;
+        /**
+         * Checks if header_timeout is positive value.
+         * @param[in] header_timeout header_timeout value from config file.
+         * @throw runtime_error If header_timeout is not valid.
+         * @see \ref HeaderTimeout "header_timeout"
+         */
+        void check_header_timeout(const string &header_timeout) const;
+        /**
+         * Checks if send_timeout is positive value.
+         * @param[in] send_timeout send_timeout value from config file.
+         * @throw runtime_error If send_timeout is not valid.
+         * @see \ref SendTimeout "send_timeout"
+         */
+        void check_send_timeout(const string &send_timeout) const;
+        /**
+         * Checks if content_cache_size is non-negative value.
+         * @param[in] content_cache_size content_cache_size value from config file.
+         * @throw runtime_error If content_cache_size is not valid.
+         * @see \ref ContentCacheSize "content_cache_size"
+         */
+        void check_content_cache_size(const string &content_cache_size) const;
+        /**
+         * Checks if metadata_cache is valid choice.
+         * @param[in] metadata_cache metadata_cache value from config file.
+         * @throw runtime_error If metadata_cache is not valid.
+         * @see \ref MetadataCache "metadata_cache"
+         */
+        void check_metadata_cache(const string &metadata_cache) const;
+        /**
+         * Checks if fd_cache_size is non-negative value.
+         * @param[in] fd_cache_size fd_cache_size value from config file.
+         * @throw runtime_error If fd_cache_size is not valid.
+         * @see \ref FdCacheSize "fd_cache_size"
+         */
+        void check_fd_cache_size(const string &fd_cache_size) const;
+        /**
+         * Checks if precompressed is valid choice.
+         * @param[in] precompressed precompressed value from config file.
+         * @throw runtime_error If precompressed is not valid.
+         * @see \ref Precompressed "precompressed"
+         */
+        void check_precompressed(const string &precompressed) const;
+        /**
+         * Checks if compression_level is value between 0 and 9.
+         * @param[in] compression_level compression_level value from config file.
+         * @throw runtime_error If compression_level is not valid.
+         * @see \ref CompressionLevel "compression_level"
+         */
+        void check_compression_level(const string &compression_level) const;
+        /**
+         * Checks if compression_min_size is non-negative value.
+         * @param[in] compression_min_size compression_min_size value from config file.
+         * @throw runtime_error If compression_min_size is not valid.
+         * @see \ref CompressionMinSize "compression_min_size"
+         */
+        void check_compression_min_size(const string &compression_min_size) const;
+        /**
+         * Checks if compression_types is comma separated list of mime types.
+         * @param[in] compression_types compression_types value from config file.
+         * @throw runtime_error If compression_types is not valid.
+         * @see \ref CompressionTypes "compression_types"
+         */
+        void check_compression_types(const string &compression_types) const;
+        /**
+         * Checks if compression_cache_size is non-negative value.
+         * @param[in] compression_cache_size compression_cache_size value from config file.
+         * @throw runtime_error If compression_cache_size is not valid.
+         * @see \ref CompressionCacheSize "compression_cache_size"
+         */
+        void check_compression_cache_size(const string &compression_cache_size) const;
+        /**
+         * Checks if response_cache_size is non-negative value.
+         * @param[in] response_cache_size response_cache_size value from config file.
+         * @throw runtime_error If response_cache_size is not valid.
+         * @see \ref ResponseCacheSize "response_cache_size"
+         */
+        void check_response_cache_size(const string &response_cache_size) const;
+        /**
+         * Checks if response_cache_max_file_size is non-negative value.
+         * @param[in] response_cache_max_file_size response_cache_max_file_size value from config file.
+         * @throw runtime_error If response_cache_max_file_size is not valid.
+         * @see \ref ResponseCacheMaxFileSize "response_cache_max_file_size"
+         */
+        void check_response_cache_max_file_size(const string &response_cache_max_file_size) const;
+        /**
+         * Checks if log_overflow is valid choice.
+         * @param[in] log_overflow log_overflow value from config file.
+         * @throw runtime_error If log_overflow is not valid.
+         * @see \ref LogOverflow "log_overflow"
+         */
+        void check_log_overflow(const string &log_overflow) const;
+        /**
+         * Checks if log_buffer_size is value between 1 and 1048576.
+         * @param[in] log_buffer_size log_buffer_size value from config file.
+         * @throw runtime_error If log_buffer_size is not valid.
+         * @see \ref LogBufferSize "log_buffer_size"
+         */
+        void check_log_buffer_size(const string &log_buffer_size) const;
+        /**
+         * Checks if log_format is valid choice.
+         * @param[in] log_format log_format value from config file.
+         * @throw runtime_error If log_format is not valid.
+         * @see \ref LogFormat "log_format"
+         */
+        void check_log_format(const string &log_format) const;
+        /**
+         * Checks if log_max_size is non-negative value.
+         * @param[in] log_max_size log_max_size value from config file.
+         * @throw runtime_error If log_max_size is not valid.
+         * @see \ref LogMaxSize "log_max_size"
+         */
+        void check_log_max_size(const string &log_max_size) const;
+        /**
+         * Checks if log_keep is value between 0 and 1000.
+         * @param[in] log_keep log_keep value from config file.
+         * @throw runtime_error If log_keep is not valid.
+         * @see \ref LogKeep "log_keep"
+         */
+        void check_log_keep(const string &log_keep) const;
+        /**
+         * Checks if log_compress is valid choice.
+         * @param[in] log_compress log_compress value from config file.
+         * @throw runtime_error If log_compress is not valid.
+         * @see \ref LogCompress "log_compress"
+         */
+        void check_log_compress(const string &log_compress) const;
+        /**
+         * Checks if log_sample is positive value.
+         * @param[in] log_sample log_sample value from config file.
+         * @throw runtime_error If log_sample is not valid.
+         * @see \ref LogSample "log_sample"
+         */
+        void check_log_sample(const string &log_sample) const;
+        /**
+         * Checks if log_slow_time is non-negative value.
+         * @param[in] log_slow_time log_slow_time value from config file.
+         * @throw runtime_error If log_slow_time is not valid.
+         * @see \ref LogSlowTime "log_slow_time"
+         */
+        void check_log_slow_time(const string &log_slow_time) const;
+        /**
+         * Checks if log_rate_limit is non-negative value.
+         * @param[in] log_rate_limit log_rate_limit value from config file.
+         * @throw runtime_error If log_rate_limit is not valid.
+         * @see \ref LogRateLimit "log_rate_limit"
+         */
+        void check_log_rate_limit(const string &log_rate_limit) const;
+        /**
+         * Checks if metrics_address is empty or starts with /.
+         * @param[in] metrics_address metrics_address value from config file.
+         * @throw runtime_error If metrics_address is not valid.
+         * @see \ref MetricsAddress "metrics_address"
+         */
+        void check_metrics_address(const string &metrics_address) const;
 };
 
 
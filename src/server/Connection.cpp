@@ -0,0 +1,345 @@
+//
+// Created by satopja2 on 17.10.26.
+//
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+
+#include "Connection.h"
+#include "../http/Scanner.h"
+
+Connection::Connection(const int &fd, const struct sockaddr_in &addr, const size_t &max_request_size) noexcept:
+    m_fd(fd), m_state(READING), m_sent(0), m_chunk_head_length(0), m_bytes_sent(0), m_request_length(0), m_scanned(0),
+    m_max_request_size(max_request_size), m_readable(false), m_request_start(0), m_requests_count(0), m_keep_alive(true), m_last_activity(time(nullptr)) {
+    // Get client IP address
+    if (inet_ntop(AF_INET, &addr.sin_addr, m_ip, sizeof(m_ip)) == NULL)
+        strncpy(m_ip, "Invalid IP", INET_ADDRSTRLEN);
+    return;
+}
+
+Connection::~Connection() {
+    close(m_fd);
+    return;
+}
+
+Connection::io_status Connection::recv_all() noexcept {
+    ssize_t recv_val = 0;
+    size_t length = 0, space = 0;
+
+    m_last_activity = time(nullptr);
+
+    // Read until socket would block or buffer is full
+    while ((length = m_request.length()) < m_max_request_size) {
+        // Receive directly to the end of buffer
+        space = min(Connection::recv_buffer_size, m_max_request_size - length);
+        m_request.resize(length + space);
+        recv_val = recv(m_fd, &m_request[length], space, 0);
+        m_request.resize(length + max(recv_val, (ssize_t)0));
+        if (recv_val > 0) {
+            // First byte of new request
+            if (length == 0)
+                m_request_start = m_last_activity;
+            continue;
+        }
+        // Client disconnected
+        if (recv_val == 0) {
+            m_readable = false;
+            return IO_CLOSED;
+        }
+        if (errno == EINTR)
+            continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            m_readable = false;
+            return IO_AGAIN;
+        }
+        return IO_ERROR;
+    }
+
+    // Buffer is full, there may be more data waiting
+    return IO_DONE;
+}
+
+void Connection::linger() noexcept {
+    shutdown(m_fd, SHUT_WR);
+    m_state = LINGERING;
+    m_request.clear();
+    m_last_activity = time(nullptr);
+    return;
+}
+
+Connection::io_status Connection::discard_all() noexcept {
+    ssize_t recv_val = 0;
+    char buffer[Connection::recv_buffer_size];
+
+    for (;;) {
+        recv_val = recv(m_fd, buffer, Connection::recv_buffer_size, 0);
+        if (recv_val > 0)
+            continue;
+        m_readable = false;
+        if (recv_val == 0)
+            return IO_CLOSED;
+        if (errno == EINTR)
+            continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return IO_AGAIN;
+        return IO_ERROR;
+    }
+}
+
+void Connection::set_readable() noexcept {
+    m_readable = true;
+    return;
+}
+
+bool Connection::is_readable() const noexcept {
+    return m_readable;
+}
+
+Connection::io_status Connection::send_all() noexcept {
+    io_status status = IO_DONE;
+
+    // Send segments until everything is sent or socket would block, sent segments are removed
+    while (!m_response.empty()) {
+        if (m_response.front().stream != nullptr)
+            status = send_stream();
+        else if (m_response.front().file == nullptr)
+            status = send_data();
+        else
+            status = send_file();
+        if (status != IO_DONE)
+            return status;
+    }
+
+    // Whole response sent, wait for next request
+    m_state = READING;
+    m_last_activity = time(nullptr);
+
+    return IO_DONE;
+}
+
+int Connection::get_stream_fd() const noexcept {
+    if (m_response.empty() || m_response.front().stream == nullptr)
+        return -1;
+    return m_response.front().stream->get_stream_fd();
+}
+
+bool Connection::is_waiting_for_stream() const noexcept {
+    return !m_response.empty() && m_response.front().stream != nullptr && m_chunk_head_length == 0;
+}
+
+bool Connection::has_request() noexcept {
+    // Request already found
+    if (m_request_length > 0)
+        return true;
+
+    // Continue searching where we stopped, end of request could be split between reads
+    auto pos_end = Scanner::find_head_end(m_request, (m_scanned > 3) ? m_scanned - 3 : 0);
+    if (pos_end == string::npos) {
+        m_scanned = m_request.length();
+        return false;
+    }
+    m_request_length = pos_end + 4;
+    return true;
+}
+
+bool Connection::is_request_too_large() noexcept {
+    return (!has_request() && m_request.length() >= m_max_request_size);
+}
+
+time_t Connection::get_request_start() const noexcept {
+    return m_request_start;
+}
+
+string_view Connection::get_request() const noexcept {
+    return string_view(m_request).substr(0, m_request_length);
+}
+
+void Connection::consume_request() noexcept {
+    m_request.erase(0, m_request_length);
+    m_request_length = 0;
+    m_scanned = 0;
+    m_request_start = time(nullptr);
+    m_requests_count++;
+    return;
+}
+
+void Connection::add_response(vector<Response::segment> &&response, const bool &keep_alive) noexcept {
+    // Pipelined responses are sent together with the first one, send timeout starts with it too
+    if (m_state == READING) {
+        m_send_start = chrono::steady_clock::now();
+        m_last_activity = time(nullptr);
+    }
+    for (auto &response_segment : response)
+        m_response.push_back(move(response_segment));
+    m_keep_alive = keep_alive;
+    m_state = WRITING;
+    return;
+}
+
+bool Connection::is_keep_alive() const noexcept {
+    return m_keep_alive;
+}
+
+chrono::steady_clock::time_point Connection::get_send_start() const noexcept {
+    return m_send_start;
+}
+
+size_t Connection::take_bytes_sent() noexcept {
+    size_t bytes_sent = m_bytes_sent;
+    m_bytes_sent = 0;
+    return bytes_sent;
+}
+
+int Connection::get_requests_count() const noexcept {
+    return m_requests_count;
+}
+
+bool Connection::has_data() const noexcept {
+    return !m_request.empty();
+}
+
+time_t Connection::get_last_activity() const noexcept {
+    return m_last_activity;
+}
+
+int Connection::get_fd() const noexcept {
+    return m_fd;
+}
+
+const char* Connection::get_ip() const noexcept {
+    return m_ip;
+}
+
+Connection::connection_state Connection::get_state() const noexcept {
+    return m_state;
+}
+
+Connection::io_status Connection::send_buffers(struct iovec *buffers, const size_t &count, const bool &more) noexcept {
+    ssize_t bytes_sent = 0;
+    size_t first = 0, skip = m_sent;
+    struct msghdr message = {};
+    int flags = MSG_NOSIGNAL | (more ? MSG_MORE : 0);
+
+    for (;;) {
+        // Skip already sent buffers and start in the middle of partially sent one
+        for (; first < count && buffers[first].iov_len <= skip; ++first)
+            skip -= buffers[first].iov_len;
+        if (first == count)
+            return IO_DONE;
+        buffers[first].iov_base = static_cast<char*>(buffers[first].iov_base) + skip;
+        buffers[first].iov_len -= skip;
+        skip = 0;
+
+        message.msg_iov = buffers + first;
+        message.msg_iovlen = count - first;
+        bytes_sent = sendmsg(m_fd, &message, flags);
+        if (bytes_sent >= 0) {
+            m_sent += bytes_sent;
+            m_bytes_sent += bytes_sent;
+            m_last_activity = time(nullptr);
+            skip = bytes_sent;
+            continue;
+        }
+        if (errno == EINTR)
+            continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return IO_AGAIN;
+        return IO_ERROR;
+    }
+}
+
+Connection::io_status Connection::send_data() noexcept {
+    io_status status = IO_DONE;
+    struct iovec buffers[Connection::max_buffers];
+    size_t count = 0;
+    string_view data;
+
+    // Gather data in memory from consecutive segments, even from following responses
+    auto segment_itr = m_response.begin();
+    for (; segment_itr != m_response.end() && count < Connection::max_buffers; ++segment_itr, ++count) {
+        if (segment_itr->file != nullptr || segment_itr->stream != nullptr)
+            break;
+        data = segment_itr->get_data();
+        buffers[count].iov_base = const_cast<char*>(data.data());
+        buffers[count].iov_len = data.length();
+    }
+
+    // Headers and body are sent together without being copied to one buffer
+    status = send_buffers(buffers, count, segment_itr != m_response.end());
+
+    // Remove fully sent segments, m_sent is kept relative to the first remaining one
+    while (count-- > 0 && m_sent >= m_response.front().get_data().length()) {
+        m_sent -= m_response.front().get_data().length();
+        m_response.pop_front();
+    }
+
+    return status;
+}
+
+Connection::io_status Connection::send_file() noexcept {
+    ssize_t bytes_sent = 0;
+    Response::segment &file = m_response.front();
+
+    // sendfile() advances offset by itself
+    while (file.length > 0) {
+        bytes_sent = sendfile(m_fd, file.file->get(), &file.offset, file.length);
+        if (bytes_sent > 0) {
+            file.length -= bytes_sent;
+            m_bytes_sent += bytes_sent;
+            m_last_activity = time(nullptr);
+            continue;
+        }
+        // File got shorter since we checked its size
+        if (bytes_sent == 0)
+            return IO_ERROR;
+        if (errno == EINTR)
+            continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return IO_AGAIN;
+        return IO_ERROR;
+    }
+
+    m_response.pop_front();
+    return IO_DONE;
+}
+
+Connection::io_status Connection::send_stream() noexcept {
+    io_status status = IO_DONE;
+    Response::segment &body = m_response.front();
+
+    for (;;) {
+        // Send rest of current chunk first, chunks of stream are sent as soon as possible
+        if (m_chunk_head_length > 0) {
+            struct iovec frame[3] = {{m_chunk_head, m_chunk_head_length}, {&m_chunk[0], m_chunk.length()},
+                    {const_cast<char*>("\r\n"), 2}};
+            status = send_buffers(frame, 3, false);
+            if (status != IO_DONE)
+                return status;
+            m_sent = 0;
+            m_chunk_head_length = 0;
+        }
+        m_chunk.clear();
+
+        switch (body.stream->read_stream(m_chunk)) {
+            case Generator::STREAM_DATA:
+                if (!m_chunk.empty())
+                    m_chunk_head_length = snprintf(m_chunk_head, sizeof(m_chunk_head), "%zx\r\n",
+                            m_chunk.length());
+                break;
+            case Generator::STREAM_AGAIN:
+                return IO_AGAIN;
+            case Generator::STREAM_END:
+                // Last chunk is sent as data in memory together with following responses
+                body.data = "0\r\n\r\n";
+                body.stream = nullptr;
+                return IO_DONE;
+            case Generator::STREAM_ERROR:
+                return IO_ERROR;
+        }
+    }
+}
@@ -0,0 +1,267 @@
+//
+// Created by satopja2 on 17.10.26.
+//
+
+#ifndef EIRSERVER_CONNECTION_H
+#define EIRSERVER_CONNECTION_H
+
+#include <string>
+#include <string_view>
+#include <deque>
+#include <vector>
+#include <ctime>
+#include <chrono>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/uio.h>
+
+#include "../http/Response.h"
+
+using namespace std;
+
+/**
+ * Class holding state of one non-blocking client connection driven by the server event loop.
+ */
+class Connection {
+    public:
+        /**
+         * Sets client socket file descriptor (m_fd), client IP address (m_ip) and maximum size of request
+         * head (m_max_request_size).
+         * @param[in] fd Non-blocking client socket file descriptor.
+         * @param[in] addr Network address information of client.
+         * @param[in] max_request_size Maximum size of buffered request data.
+         */
+        Connection(const int &fd, const struct sockaddr_in &addr, const size_t &max_request_size) noexcept;
+        /**
+         * Closes client socket.
+         */
+        ~Connection();
+        /**
+         * Enum holding states of connection state machine.
+         */
+        enum connection_state {
+            READING,
+            WRITING,
+            LINGERING
+        };
+        /**
+         * Enum holding results of non-blocking socket operations.
+         */
+        enum io_status {
+            IO_DONE,
+            IO_AGAIN,
+            IO_CLOSED,
+            IO_ERROR
+        };
+        /**
+         * Receives data available on client socket directly to the end of m_request, but never more than
+         * m_max_request_size bytes are buffered. Updates time of last activity on connection.
+         * @return IO_ERROR if recv() encountered error, IO_CLOSED if client disconnected, IO_AGAIN if
+         * there is no more data to be read right now, IO_DONE if buffer is full and more data may be waiting.
+         * @note Because sockets are registered as edge-triggered, we need to read until recv() would block,
+         * otherwise we would not be notified about the remaining data again. If we stop reading because buffer
+         * is full, connection stays readable (m_readable) and we need to call this again once buffered requests
+         * are handled.
+         */
+        io_status recv_all() noexcept;
+        /**
+         * Shuts down sending side of client socket and switches connection to LINGERING state, in which all
+         * received data are discarded until client closes its side too.
+         * @note If we closed socket with unread data, kernel would reset the connection and client could lose
+         * the last response before reading it.
+         */
+        void linger() noexcept;
+        /**
+         * Receives and discards all data currently available on client socket.
+         * @return IO_ERROR if recv() encountered error, IO_CLOSED if client disconnected, IO_AGAIN if
+         * there is no more data to be read right now.
+         */
+        io_status discard_all() noexcept;
+        /**
+         * Marks connection as readable (m_readable) after edge-triggered notification.
+         */
+        void set_readable() noexcept;
+        /**
+         * Checks if there may be data waiting on client socket which we did not read yet (m_readable).
+         * @return true if socket may be readable, false otherwise.
+         */
+        bool is_readable() const noexcept;
+        /**
+         * Sends as much of queued response segments as client socket accepts and removes sent ones. Consecutive
+         * data in memory are gathered to one sendmsg(), files are sent by sendfile() straight from page cache,
+         * streamed bodies in chunks as they are generated. Once all responses are sent switches connection back
+         * to READING state.
+         * @return IO_ERROR if sendmsg() or sendfile() encountered error or stream failed, IO_AGAIN if socket would
+         * block or stream has no data yet, IO_DONE if whole response was sent.
+         */
+        io_status send_all() noexcept;
+        /**
+         * Gets file descriptor on which streamed body currently being sent waits for data.
+         * @return Int representing file descriptor, -1 if connection does not wait for stream.
+         */
+        int get_stream_fd() const noexcept;
+        /**
+         * Checks if sending waits for streamed body to generate more data rather than for client to read.
+         * @return true if whole generated part of streamed body was sent, false otherwise.
+         */
+        bool is_waiting_for_stream() const noexcept;
+        /**
+         * Checks if m_request starts with complete HTTP request head (ends with empty line) and stores its
+         * length to m_request_length.
+         * @return true if request is complete, false otherwise.
+         * @note Position up to which m_request was already searched is remembered in m_scanned, so bytes
+         * received in earlier reads are not searched again.
+         */
+        bool has_request() noexcept;
+        /**
+         * Checks if buffered incomplete request head reached m_max_request_size.
+         * @return true if request head is too large, false otherwise.
+         */
+        bool is_request_too_large() noexcept;
+        /**
+         * Gets time when first byte of currently buffered incomplete request was received (m_request_start).
+         * @return Time of first received byte of request.
+         */
+        time_t get_request_start() const noexcept;
+        /**
+         * Gets first complete request from received data without copying it.
+         * @return String view of first complete request, valid until consume_request() is called.
+         * @note Client may pipeline more requests, so m_request can contain more than one of them.
+         */
+        string_view get_request() const noexcept;
+        /**
+         * Removes first complete request from received data and counts it as handled.
+         */
+        void consume_request() noexcept;
+        /**
+         * Appends response segments to be sent to m_response and switches connection to WRITING state. Response
+         * queued to connection which has nothing to send starts measuring of sending time (m_send_start).
+         * @param[in] response Segments of full HTTP response.
+         * @param[in] keep_alive Whether connection should stay open after sending response.
+         * @note Responses to pipelined requests are appended in the same order as requests arrived.
+         */
+        void add_response(vector<Response::segment> &&response, const bool &keep_alive) noexcept;
+        /**
+         * Gets time at which connection started sending currently queued responses (m_send_start).
+         * @return Time point of first response queued after connection had nothing to send.
+         */
+        chrono::steady_clock::time_point get_send_start() const noexcept;
+        /**
+         * Gets number of bytes sent since last call and resets it (m_bytes_sent).
+         * @return Number of bytes sent to client.
+         */
+        size_t take_bytes_sent() noexcept;
+        /**
+         * Checks if connection may handle more requests (m_keep_alive).
+         * @return true if connection should stay open, false otherwise.
+         */
+        bool is_keep_alive() const noexcept;
+        /**
+         * Gets number of requests handled on connection (m_requests_count).
+         * @return Int representing number of handled requests.
+         */
+        int get_requests_count() const noexcept;
+        /**
+         * Checks if any data were received on connection since last handled request.
+         * @return true if m_request is not empty, false otherwise.
+         */
+        bool has_data() const noexcept;
+        /**
+         * Gets time of last activity on connection (m_last_activity).
+         * @return Time of last received data, queued response or progress in sending it.
+         */
+        time_t get_last_activity() const noexcept;
+        /**
+         * Gets client socket file descriptor (m_fd).
+         * @return Int representing client socket file descriptor.
+         */
+        int get_fd() const noexcept;
+        /**
+         * Gets client IP address (m_ip).
+         * @return Pointer to C string containing client IP address.
+         */
+        const char* get_ip() const noexcept;
+        /**
+         * Gets current state of connection (m_state).
+         * @return State of connection.
+         */
+        connection_state get_state() const noexcept;
+    private:
+        /** Static member holding by how many bytes is m_request grown before recv(). */
+        static constexpr size_t recv_buffer_size = 4096;
+        /** Static member holding maximum number of segments gathered to one sendmsg(). */
+        static constexpr size_t max_buffers = 64;
+        /** Member holding client socket file descriptor. */
+        int m_fd;
+        /** Member holding client IP address. */
+        char m_ip[INET_ADDRSTRLEN];
+        /** Member holding current state of connection. */
+        connection_state m_state;
+        /** Member holding received request data. */
+        string m_request;
+        /** Member queue holding response segments to be sent. */
+        deque<Response::segment> m_response;
+        /** Member holding how many bytes of first segment in m_response (or of current chunk) were already sent. */
+        size_t m_sent;
+        /** Member holding last part of streamed body read from generator. */
+        string m_chunk;
+        /** Member holding size line of m_chunk in chunked transfer coding. */
+        char m_chunk_head[20];
+        /** Member holding length of m_chunk_head, 0 if there is no chunk to be sent. */
+        size_t m_chunk_head_length;
+        /** Member holding number of bytes sent since take_bytes_sent() was called. */
+        size_t m_bytes_sent;
+        /** Member holding time at which connection started sending currently queued responses. */
+        chrono::steady_clock::time_point m_send_start;
+        /**
+         * Sends buffers by sendmsg() until all of them are sent or socket would block. Partial writes are handled
+         * by skipping sent buffers and advancing the first partially sent one, m_sent is increased by sent bytes.
+         * @param[in,out] buffers Buffers to be sent, the first m_sent bytes of them were already sent.
+         * @param[in] count Number of buffers.
+         * @param[in] more Whether more data follow, so the kernel should wait for them before sending a partial
+         * packet.
+         * @return IO_ERROR if sendmsg() encountered error, IO_AGAIN if socket would block, IO_DONE if all
+         * buffers were sent.
+         */
+        io_status send_buffers(struct iovec *buffers, const size_t &count, const bool &more) noexcept;
+        /**
+         * Sends data in memory from all consecutive segments at front of m_response (up to max_buffers of them)
+         * at once as client socket accepts, so headers and body are never copied to one buffer.
+         * @return IO_ERROR if sendmsg() encountered error, IO_AGAIN if socket would block, IO_DONE if
+         * gathered segments were sent.
+         */
+        io_status send_data() noexcept;
+        /**
+         * Sends as much of file from first segment in m_response as client socket accepts using sendfile().
+         * @return IO_ERROR if sendfile() encountered error, IO_AGAIN if socket would block, IO_DONE if
+         * whole segment was sent.
+         */
+        io_status send_file() noexcept;
+        /**
+         * Sends chunks of streamed body from first segment in m_response as long as generator produces them
+         * and client socket accepts them. Every chunk is framed by chunked transfer coding without copying it,
+         * last empty chunk is left in the segment as data in memory.
+         * @return IO_ERROR if sendmsg() encountered error or stream failed, IO_AGAIN if socket would block or
+         * stream has no data yet, IO_DONE if whole body was generated.
+         */
+        io_status send_stream() noexcept;
+        /** Member holding length of first complete request in m_request. */
+        size_t m_request_length;
+        /** Member holding up to which position was m_request searched for end of request head. */
+        size_t m_scanned;
+        /** Member holding maximum number of bytes buffered in m_request. */
+        size_t m_max_request_size;
+        /** Member holding whether there may be unread data waiting on client socket. */
+        bool m_readable;
+        /** Member holding time when first byte of currently buffered request was received. */
+        time_t m_request_start;
+        /** Member holding number of requests handled on connection. */
+        int m_requests_count;
+        /** Member holding whether connection may handle more requests. */
+        bool m_keep_alive;
+        /** Member holding time of last activity on connection. */
+        time_t m_last_activity;
+};
+
+
+#endif //EIRSERVER_CONNECTION_H
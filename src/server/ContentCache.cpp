@@ -0,0 +1,219 @@
+//
+// Created by satopja2 on 17.10.26.
+//
+
+#include <functional>
+#include <algorithm>
+#include <cerrno>
+#include <new>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "ContentCache.h"
+
+bool ContentCache::find_file(const string &path, const struct stat &status, struct content &file_content) noexcept {
+    size_t key_hash = hash<string>{}(path);
+
+    // Disabled cache
+    if (m_shard_size == 0)
+        return false;
+
+    struct shard &entries_shard = m_shards[key_hash % ContentCache::shard_count];
+    lock_guard<mutex> lock(entries_shard.lock);
+    entries_shard.frequency.increment(key_hash);
+    auto entries_itr = entries_shard.entries.find(path);
+
+    // File not found in cache
+    if (entries_itr == entries_shard.entries.end())
+        return false;
+
+    // File found but changed
+    if (!is_valid(entries_itr->second, status)) {
+        erase(entries_shard, path);
+        return false;
+    }
+
+    // Found valid cache entry, mark it as most recently used
+    entries_shard.lru.splice(entries_shard.lru.begin(), entries_shard.lru, entries_itr->second.lru_itr);
+    file_content = entries_itr->second.file_content;
+
+    return true;
+}
+
+shared_ptr<const string> ContentCache::add_file(const string &path, const FileDescriptor &file, const struct stat &status,
+        const bool &is_text_file) noexcept {
+    size_t key_hash = hash<string>{}(path);
+
+    // Disabled cache
+    if (m_shard_size == 0)
+        return nullptr;
+
+    // File larger than whole shard would never fit
+    if (!S_ISREG(status.st_mode) || static_cast<size_t>(status.st_size) > m_shard_size)
+        return nullptr;
+
+    struct shard &entries_shard = m_shards[key_hash % ContentCache::shard_count];
+    {
+        lock_guard<mutex> lock(entries_shard.lock);
+        if (!admit(entries_shard, path, key_hash, status.st_size))
+            return nullptr;
+    }
+
+    // Read file contents, outside of shard lock
+    auto data = read_file(file, status.st_size);
+    if (data == nullptr)
+        return nullptr;
+
+    lock_guard<mutex> lock(entries_shard.lock);
+    insert(entries_shard, path, {data, is_text_file}, status);
+    return data;
+}
+
+bool ContentCache::add_data(const string &key, shared_ptr<const string> data, const struct stat &status,
+        const bool &is_text_file) noexcept {
+    size_t key_hash = hash<string>{}(key);
+
+    // Disabled cache or data larger than whole shard
+    if (m_shard_size == 0 || data->length() > m_shard_size)
+        return false;
+
+    struct shard &entries_shard = m_shards[key_hash % ContentCache::shard_count];
+    lock_guard<mutex> lock(entries_shard.lock);
+    if (!admit(entries_shard, key, key_hash, data->length()))
+        return false;
+    insert(entries_shard, key, {move(data), is_text_file}, status);
+
+    return true;
+}
+
+size_t ContentCache::get_max_size() const noexcept {
+    return m_shard_size;
+}
+
+size_t ContentCache::get_used_size() noexcept {
+    size_t size = 0;
+
+    for (auto &entries_shard : m_shards) {
+        lock_guard<mutex> lock(entries_shard.lock);
+        size += entries_shard.size;
+    }
+
+    return size;
+}
+
+size_t ContentCache::get_entries_count() noexcept {
+    size_t count = 0;
+
+    for (auto &entries_shard : m_shards) {
+        lock_guard<mutex> lock(entries_shard.lock);
+        count += entries_shard.entries.size();
+    }
+
+    return count;
+}
+
+shared_ptr<string> ContentCache::read_file(const FileDescriptor &file, const size_t &size) noexcept {
+    ssize_t bytes_read = 0;
+    shared_ptr<string> data = nullptr;
+
+    // Large file may not fit to memory, it is then sent without being read
+    try {
+        data = make_shared<string>(size, '\0');
+    } catch (const bad_alloc& e) {
+        return nullptr;
+    }
+
+    for (size_t offset = 0; offset < size; offset += bytes_read) {
+        bytes_read = pread(file.get(), &(*data)[offset], size - offset, offset);
+        if (bytes_read < 0 && errno == EINTR) {
+            bytes_read = 0;
+            continue;
+        }
+        // File got shorter since we checked its size
+        if (bytes_read <= 0)
+            return nullptr;
+    }
+
+    return data;
+}
+
+bool ContentCache::admit(struct shard &entries_shard, const string &key, const size_t &key_hash,
+        const size_t &needed) noexcept {
+    if (entries_shard.entries.count(key) > 0)
+        return false;
+
+    // Admit entry only if it is requested more often than every entry it would evict
+    uint8_t frequency = entries_shard.frequency.estimate(key_hash);
+    size_t freed = m_shard_size - entries_shard.size;
+    for (auto lru_itr = entries_shard.lru.rbegin(); freed < needed && lru_itr != entries_shard.lru.rend(); ++lru_itr) {
+        if (entries_shard.frequency.estimate(hash<string>{}(*lru_itr)) >= frequency)
+            return false;
+        freed += entries_shard.entries[*lru_itr].file_content.data->length();
+    }
+
+    return true;
+}
+
+void ContentCache::insert(struct shard &entries_shard, const string &key, const struct content &file_content,
+        const struct stat &status) noexcept {
+    size_t needed = file_content.data->length();
+
+    // Evict least recently used entries to make space for new entry
+    if (entries_shard.entries.count(key) > 0)
+        erase(entries_shard, key);
+    while (m_shard_size - entries_shard.size < needed && !entries_shard.lru.empty())
+        erase(entries_shard, entries_shard.lru.back());
+    entries_shard.lru.push_front(key);
+    entries_shard.entries[key] = {file_content, status.st_dev, status.st_ino, status.st_mtim, status.st_ctim,
+            status.st_size, entries_shard.lru.begin()};
+    entries_shard.size += needed;
+
+    return;
+}
+
+void ContentCache::erase(struct shard &entries_shard, const string &path) noexcept {
+    auto entries_itr = entries_shard.entries.find(path);
+    if (entries_itr == entries_shard.entries.end())
+        return;
+    entries_shard.size -= entries_itr->second.file_content.data->length();
+    entries_shard.lru.erase(entries_itr->second.lru_itr);
+    entries_shard.entries.erase(entries_itr);
+    return;
+}
+
+bool ContentCache::is_valid(const struct file &entry, const struct stat &status) noexcept {
+    return entry.device == status.st_dev && entry.inode == status.st_ino && entry.size == status.st_size
+            && entry.last_mod.tv_sec == status.st_mtim.tv_sec && entry.last_mod.tv_nsec == status.st_mtim.tv_nsec
+            && entry.last_change.tv_sec == status.st_ctim.tv_sec && entry.last_change.tv_nsec == status.st_ctim.tv_nsec;
+}
+
+void ContentCache::frequency_sketch::increment(const size_t &key_hash) noexcept {
+    for (size_t row = 0; row < frequency_sketch::depth; ++row) {
+        uint8_t &counter = m_counters[row][get_index(key_hash, row)];
+        if (counter < 15)
+            counter++;
+    }
+
+    // Halve all counters, so files popular long ago do not stay in cache forever
+    if (++m_increments >= frequency_sketch::sample_size) {
+        for (auto &row : m_counters)
+            for (auto &counter : row)
+                counter >>= 1;
+        m_increments = 0;
+    }
+
+    return;
+}
+
+uint8_t ContentCache::frequency_sketch::estimate(const size_t &key_hash) const noexcept {
+    uint8_t frequency = 15;
+    for (size_t row = 0; row < frequency_sketch::depth; ++row)
+        frequency = min(frequency, m_counters[row][get_index(key_hash, row)]);
+    return frequency;
+}
+
+size_t ContentCache::frequency_sketch::get_index(const size_t &key_hash, const size_t &row) noexcept {
+    // Mix hash differently for every row (Fibonacci hashing)
+    uint64_t mixed = (static_cast<uint64_t>(key_hash) + row * 0x632be59bd9b4e019ULL) * 0x9e3779b97f4a7c15ULL;
+    return (mixed >> 32) % frequency_sketch::width;
+}
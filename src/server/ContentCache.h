@@ -0,0 +1,214 @@
+//
+// Created by satopja2 on 17.10.26.
+//
+
+#ifndef EIRSERVER_CONTENT_CACHE_H
+#define EIRSERVER_CONTENT_CACHE_H
+
+#include <array>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "FileDescriptor.h"
+
+using namespace std;
+
+/**
+ * Class storing contents of frequently requested files in memory, so they can be served without reading them.
+ * @note Cache is shared by all workers, so entries are split into shards by hash of their path, each guarded
+ * by its own mutex and holding its part of \ref ContentCacheSize "content_cache_size" bytes. Shard evicts least
+ * recently used entries, but new file is admitted only if it was requested more often than the entry it would
+ * evict (TinyLFU), so one-off requests cannot flush hot files out of the cache.
+ */
+class ContentCache {
+    public:
+        /**
+         * Sets how many bytes of file contents may be cached (m_shard_size is its part for every shard).
+         * @param[in] size Maximum size of all cached file contents in bytes (0 disables cache).
+         */
+        ContentCache(const size_t &size): m_shard_size(size / ContentCache::shard_count) {}
+        /**
+         * Struct holding cached file contents.
+         */
+        struct content {
+            /** Member holding file data shared with responses which are still being sent. */
+            shared_ptr<const string> data;
+            /** Member holding whether file looks like text file. */
+            bool is_text_file;
+        };
+        /**
+         * Searches cache for contents of file with given path and counts request of file. Cached entry is used
+         * only if it is still the same file (device and inode) and its size, modification and status change times
+         * (with nanoseconds) did not change since it was cached.
+         * @param[in] path Absolute path of requested file.
+         * @param[in] status Status of requested file, read once when it was opened.
+         * @param[out] file_content Cached contents of file.
+         * @return true if valid file contents were found, false otherwise.
+         */
+        bool find_file(const string &path, const struct stat &status, struct content &file_content) noexcept;
+        /**
+         * Reads contents of open file and adds them to cache if file fits to cache and admission policy
+         * accepts it.
+         * @param[in] path Absolute path of file.
+         * @param[in] file Open file.
+         * @param[in] status Status of open file.
+         * @param[in] is_text_file Whether file looks like text file.
+         * @return Pointer to cached file data, nullptr if file was not cached.
+         */
+        shared_ptr<const string> add_file(const string &path, const FileDescriptor &file, const struct stat &status,
+                const bool &is_text_file) noexcept;
+        /**
+         * Adds data derived from file (for example its compressed variant) to cache if they fit to cache and
+         * admission policy accepts them. Entry is valid as long as status of original file does not change.
+         * @param[in] key Key of data, absolute path of original file with suffix which cannot be in any path.
+         * @param[in] data Data to be cached.
+         * @param[in] status Status of original file.
+         * @param[in] is_text_file Whether original file looks like text file.
+         * @return true if data were cached, false otherwise.
+         */
+        bool add_data(const string &key, shared_ptr<const string> data, const struct stat &status,
+                const bool &is_text_file) noexcept;
+        /**
+         * Gets size of largest entry which may be cached (m_shard_size).
+         * @return Size in bytes, 0 if cache is disabled.
+         */
+        size_t get_max_size() const noexcept;
+        /**
+         * Gets size of all cached data. Locks every shard in turn, so it is meant only for occasional reports.
+         * @return Size in bytes.
+         */
+        size_t get_used_size() noexcept;
+        /**
+         * Gets number of cached entries. Locks every shard in turn, so it is meant only for occasional reports.
+         * @return Number of entries.
+         */
+        size_t get_entries_count() noexcept;
+        /**
+         * Reads whole contents of open file.
+         * @param[in] file Open file.
+         * @param[in] size Size of file.
+         * @return Pointer to file data, nullptr if file cannot be read, got shorter or memory for it cannot be
+         * allocated.
+         */
+        static shared_ptr<string> read_file(const FileDescriptor &file, const size_t &size) noexcept;
+    private:
+        /**
+         * Class approximately counting how often were keys requested using count-min sketch of 4-bit counters.
+         * @note Counters are halved after every sample_size increments, so old popularity fades away.
+         */
+        class frequency_sketch {
+            public:
+                /**
+                 * Counts one request of key.
+                 * @param[in] key_hash Hash of requested key.
+                 */
+                void increment(const size_t &key_hash) noexcept;
+                /**
+                 * Estimates how many times was key requested.
+                 * @param[in] key_hash Hash of key.
+                 * @return Estimated number of requests (at most 15).
+                 */
+                uint8_t estimate(const size_t &key_hash) const noexcept;
+            private:
+                /** Static member holding number of counters in one row. */
+                static const size_t width = 1024;
+                /** Static member holding number of rows (independent hashes of one key). */
+                static const size_t depth = 4;
+                /** Static member holding after how many increments are all counters halved. */
+                static const size_t sample_size = 10 * width;
+                /** Member array holding counters of all rows. */
+                array<array<uint8_t, width>, depth> m_counters = {};
+                /** Member holding number of increments since counters were halved. */
+                size_t m_increments = 0;
+                /**
+                 * Gets position of counter of key in given row.
+                 * @param[in] key_hash Hash of key.
+                 * @param[in] row Row of counter.
+                 * @return Position of counter in row.
+                 */
+                static size_t get_index(const size_t &key_hash, const size_t &row) noexcept;
+        };
+        /**
+         * Struct storing one cache entry.
+         */
+        struct file {
+            /** Member holding cached file contents. */
+            struct content file_content;
+            /** Member holding device of cached file. */
+            dev_t device;
+            /** Member holding inode of cached file. */
+            ino_t inode;
+            /** Member holding last modification time of cached file. */
+            struct timespec last_mod;
+            /** Member holding last status change time of cached file. */
+            struct timespec last_change;
+            /** Member holding size of cached file. */
+            off_t size;
+            /** Member holding position of entry in shard LRU list. */
+            list<string>::iterator lru_itr;
+        };
+        /**
+         * Struct storing one part of cache entries.
+         */
+        struct shard {
+            /** Member guarding entries of shard. */
+            mutex lock;
+            /** Member map storing cache entries of shard. */
+            unordered_map<string, struct file> entries;
+            /** Member list holding paths of entries from most to least recently used. */
+            list<string> lru;
+            /** Member holding size of all cached file contents in shard. */
+            size_t size = 0;
+            /** Member counting requests of files in shard. */
+            frequency_sketch frequency;
+        };
+        /** Static member holding number of cache shards. */
+        static const size_t shard_count = 16;
+        /** Member array storing all cache entries split into shards. */
+        array<struct shard, shard_count> m_shards;
+        /** Member holding maximum size of cached file contents in one shard. */
+        size_t m_shard_size;
+        /**
+         * Removes entry from shard. Shard has to be locked.
+         * @param[in] entries_shard Shard of entry.
+         * @param[in] path Absolute path of cached file.
+         */
+        void erase(struct shard &entries_shard, const string &path) noexcept;
+        /**
+         * Checks if cached entry still matches file with given status.
+         * @param[in] entry Cached entry.
+         * @param[in] status Current status of file.
+         * @return true if file did not change since it was cached, false otherwise.
+         */
+        static bool is_valid(const struct file &entry, const struct stat &status) noexcept;
+        /**
+         * Checks if new entry should be cached, it has to be requested more often than every entry it would
+         * evict. Shard has to be locked.
+         * @param[in] entries_shard Shard of entry.
+         * @param[in] key Key of entry.
+         * @param[in] key_hash Hash of key.
+         * @param[in] needed Size of entry data.
+         * @return true if entry should be cached, false otherwise.
+         */
+        bool admit(struct shard &entries_shard, const string &key, const size_t &key_hash,
+                const size_t &needed) noexcept;
+        /**
+         * Inserts entry to shard, least recently used entries are evicted to make space for it. Shard has to
+         * be locked.
+         * @param[in] entries_shard Shard of entry.
+         * @param[in] key Key of entry.
+         * @param[in] file_content Data of entry.
+         * @param[in] status Status of file from which data were read.
+         */
+        void insert(struct shard &entries_shard, const string &key, const struct content &file_content,
+                const struct stat &status) noexcept;
+};
+
+
+#endif //EIRSERVER_CONTENT_CACHE_H
@@ -0,0 +1,77 @@
+//
+// Created by satopja2 on 17.10.26.
+//
+
+#include <functional>
+
+#include "DescriptorCache.h"
+
+bool DescriptorCache::is_enabled() const noexcept {
+    return m_shard_max_entries > 0;
+}
+
+shared_ptr<FileDescriptor> DescriptorCache::find_file(const string &path, const struct stat &status) noexcept {
+    // Disabled cache
+    if (m_shard_max_entries == 0)
+        return nullptr;
+
+    struct shard &entries_shard = m_shards[hash<string>{}(path) % DescriptorCache::shard_count];
+    lock_guard<mutex> lock(entries_shard.lock);
+    auto entries_itr = entries_shard.entries.find(path);
+
+    // File not found in cache
+    if (entries_itr == entries_shard.entries.end())
+        return nullptr;
+
+    // Path leads to another file or file changed
+    const struct file &entry = entries_itr->second;
+    if (entry.device != status.st_dev || entry.inode != status.st_ino
+            || entry.last_mod.tv_sec != status.st_mtim.tv_sec || entry.last_mod.tv_nsec != status.st_mtim.tv_nsec) {
+        erase(entries_shard, path);
+        return nullptr;
+    }
+
+    // Found valid cache entry, mark it as most recently used
+    entries_shard.lru.splice(entries_shard.lru.begin(), entries_shard.lru, entry.lru_itr);
+
+    return entry.descriptor;
+}
+
+void DescriptorCache::add_file(const string &path, const shared_ptr<FileDescriptor> &file,
+        const struct stat &status) noexcept {
+    // Disabled cache
+    if (m_shard_max_entries == 0 || file == nullptr || !S_ISREG(status.st_mode))
+        return;
+
+    struct shard &entries_shard = m_shards[hash<string>{}(path) % DescriptorCache::shard_count];
+    lock_guard<mutex> lock(entries_shard.lock);
+
+    // Replace older file, evict least recently used file to make space for new one
+    erase(entries_shard, path);
+    if (entries_shard.entries.size() >= m_shard_max_entries)
+        erase(entries_shard, entries_shard.lru.back());
+    entries_shard.lru.push_front(path);
+    entries_shard.entries[path] = {file, status.st_dev, status.st_ino, status.st_mtim, entries_shard.lru.begin()};
+
+    return;
+}
+
+size_t DescriptorCache::get_entries_count() noexcept {
+    size_t count = 0;
+
+    for (auto &entries_shard : m_shards) {
+        lock_guard<mutex> lock(entries_shard.lock);
+        count += entries_shard.entries.size();
+    }
+
+    return count;
+}
+
+void DescriptorCache::erase(struct shard &entries_shard, const string &path) noexcept {
+    auto entries_itr = entries_shard.entries.find(path);
+    if (entries_itr == entries_shard.entries.end())
+        return;
+    entries_shard.lru.erase(entries_itr->second.lru_itr);
+    entries_shard.entries.erase(entries_itr);
+    return;
+}
@@ -0,0 +1,102 @@
+//
+// Created by satopja2 on 17.10.26.
+//
+
+#ifndef EIRSERVER_DESCRIPTOR_CACHE_H
+#define EIRSERVER_DESCRIPTOR_CACHE_H
+
+#include <array>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <sys/stat.h>
+
+#include "FileDescriptor.h"
+
+using namespace std;
+
+/**
+ * Class keeping frequently requested regular files open, so they do not need to be opened and closed again
+ * for every request.
+ * @note Cache is shared by all workers, so entries are split into shards by hash of their path, each guarded
+ * by its own mutex and holding its part of \ref FdCacheSize "fd_cache_size" files. Shard evicts least recently
+ * used entries. Evicted file stays open until all responses which are still sending it are sent.
+ */
+class DescriptorCache {
+    public:
+        /**
+         * Sets how many files may be kept open (m_shard_max_entries is its part for every shard).
+         * @param[in] size Maximum number of open files (0 disables cache).
+         */
+        DescriptorCache(const size_t &size):
+            m_shard_max_entries((size + DescriptorCache::shard_count - 1) / DescriptorCache::shard_count) {}
+        /**
+         * Checks if files may be cached.
+         * @return true if cache is enabled, false otherwise.
+         */
+        bool is_enabled() const noexcept;
+        /**
+         * Searches cache for open file with given path. Cached file is used only if path still leads to the
+         * same file (device and inode) and its modification time did not change since it was opened.
+         * @param[in] path Absolute path of requested file.
+         * @param[in] status Current status of file in path.
+         * @return Pointer to open file, nullptr if valid file was not found.
+         */
+        shared_ptr<FileDescriptor> find_file(const string &path, const struct stat &status) noexcept;
+        /**
+         * Adds open regular file to cache, least recently used file is evicted if shard is full.
+         * @param[in] path Absolute path of file.
+         * @param[in] file Open file.
+         * @param[in] status Status of open file.
+         */
+        void add_file(const string &path, const shared_ptr<FileDescriptor> &file, const struct stat &status) noexcept;
+        /**
+         * Gets number of open files in cache. Locks every shard in turn, so it is meant only for occasional reports.
+         * @return Number of entries.
+         */
+        size_t get_entries_count() noexcept;
+    private:
+        /**
+         * Struct storing one cache entry.
+         */
+        struct file {
+            /** Member holding open file shared with responses which are still being sent. */
+            shared_ptr<FileDescriptor> descriptor;
+            /** Member holding device of open file. */
+            dev_t device;
+            /** Member holding inode of open file. */
+            ino_t inode;
+            /** Member holding last modification time of open file. */
+            struct timespec last_mod;
+            /** Member holding position of entry in shard LRU list. */
+            list<string>::iterator lru_itr;
+        };
+        /**
+         * Struct storing one part of cache entries.
+         */
+        struct shard {
+            /** Member guarding entries of shard. */
+            mutex lock;
+            /** Member map storing cache entries of shard. */
+            unordered_map<string, struct file> entries;
+            /** Member list holding paths of entries from most to least recently used. */
+            list<string> lru;
+        };
+        /** Static member holding number of cache shards. */
+        static const size_t shard_count = 16;
+        /** Member array storing all cache entries split into shards. */
+        array<struct shard, shard_count> m_shards;
+        /** Member holding maximum number of open files in one shard. */
+        size_t m_shard_max_entries;
+        /**
+         * Removes entry from shard. Shard has to be locked.
+         * @param[in] entries_shard Shard of entry.
+         * @param[in] path Absolute path of cached file.
+         */
+        void erase(struct shard &entries_shard, const string &path) noexcept;
+};
+
+
+#endif //EIRSERVER_DESCRIPTOR_CACHE_H
@@ -0,0 +1,17 @@
+//
+// Created by satopja2 on 17.10.26.
+//
+
+#include <unistd.h>
+
+#include "FileDescriptor.h"
+
+FileDescriptor::~FileDescriptor() {
+    if (m_fd >= 0)
+        close(m_fd);
+    return;
+}
+
+int FileDescriptor::get() const noexcept {
+    return m_fd;
+}
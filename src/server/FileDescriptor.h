@@ -0,0 +1,45 @@
+//
+// Created by satopja2 on 17.10.26.
+//
+
+#ifndef EIRSERVER_FILE_DESCRIPTOR_H
+#define EIRSERVER_FILE_DESCRIPTOR_H
+
+using namespace std;
+
+/**
+ * Class owning open file descriptor and closing it once it is no longer needed.
+ * @note It is meant to be shared through shared_ptr, so the file stays open as long as anybody
+ * (for example response which is still being sent) uses it.
+ */
+class FileDescriptor {
+    public:
+        /**
+         * Takes ownership of given file descriptor (m_fd).
+         * @param[in] fd Open file descriptor.
+         */
+        explicit FileDescriptor(const int &fd) noexcept: m_fd(fd) {}
+        /**
+         * Closes owned file descriptor.
+         */
+        ~FileDescriptor();
+        /**
+         * Copying would close the same file descriptor twice.
+         */
+        FileDescriptor(const FileDescriptor &) = delete;
+        /**
+         * Copying would close the same file descriptor twice.
+         */
+        FileDescriptor& operator =(const FileDescriptor &) = delete;
+        /**
+         * Gets owned file descriptor (m_fd).
+         * @return Int representing owned file descriptor.
+         */
+        int get() const noexcept;
+    private:
+        /** Member holding owned file descriptor. */
+        int m_fd;
+};
+
+
+#endif //EIRSERVER_FILE_DESCRIPTOR_H
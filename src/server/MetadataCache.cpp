@@ -0,0 +1,369 @@
+//
+// Created by satopja2 on 17.10.26.
+//
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <ctime>
+#include <functional>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "MetadataCache.h"
+
+MetadataCache::MetadataCache(const string &root, const bool &enabled, const size_t &max_entries):
+    m_shard_max_entries((max_entries + MetadataCache::shard_count - 1) / MetadataCache::shard_count),
+    m_inotify_fd(-1), m_stop_fd(-1), m_generation(0) {
+    // Disabled cache
+    if (!enabled)
+        return;
+
+    // Watched directories are identified by their real path
+    char *root_path = realpath(root.c_str(), nullptr);
+    if (root_path == nullptr)
+        return;
+    m_root = root_path;
+    free(root_path);
+
+    // Without inotify we would not know when to remove entries, so nothing is cached
+    m_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotify_fd < 0)
+        return;
+    m_stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_stop_fd < 0) {
+        close(m_inotify_fd);
+        m_inotify_fd = -1;
+        return;
+    }
+
+    m_watcher = thread(&MetadataCache::watch_events, this);
+    return;
+}
+
+MetadataCache::~MetadataCache() {
+    if (m_watcher.joinable()) {
+        eventfd_write(m_stop_fd, 1);
+        m_watcher.join();
+    }
+    if (m_stop_fd >= 0)
+        close(m_stop_fd);
+    if (m_inotify_fd >= 0)
+        close(m_inotify_fd);
+    return;
+}
+
+bool MetadataCache::find_file(const string &path, struct stat &status, bool &exists) noexcept {
+    string key;
+
+    // Disabled cache or path which is never cached
+    if (m_inotify_fd < 0 || !get_key(path, key))
+        return false;
+
+    struct shard &entries_shard = get_shard(key);
+    lock_guard<mutex> lock(entries_shard.lock);
+    auto entry = entries_shard.entries.find(key);
+    if (entry == entries_shard.entries.end() || !entry->second.cacheable)
+        return false;
+
+    exists = entry->second.exists;
+    if (exists)
+        status = entry->second.status;
+    return true;
+}
+
+void MetadataCache::add_file(const string &path, const FileDescriptor &file) noexcept {
+    string key;
+    struct file entry;
+    struct stat path_status;
+
+    // Disabled cache or path which is never cached
+    if (m_inotify_fd < 0 || !get_key(path, key) || is_rejected(key))
+        return;
+
+    // Every change made after generation is read either changes it or happens after watches are added
+    unsigned long generation = m_generation.load();
+    if (!watch_parents(key)) {
+        reject(key, generation, true);
+        return;
+    }
+
+    // Status is read again, file could have changed before its directory was watched
+    entry.exists = true;
+    entry.cacheable = true;
+    if (fstat(file.get(), &entry.status) < 0)
+        return;
+
+    // Path may no longer lead to opened file
+    if (stat((m_root + key).c_str(), &path_status) < 0 || path_status.st_dev != entry.status.st_dev
+            || path_status.st_ino != entry.status.st_ino)
+        return;
+
+    // Target of symbolic link is in directory which is not watched
+    if (!is_real_path(key)) {
+        reject(key, generation, false);
+        return;
+    }
+
+    // Contents of directory are watched too, so new files change its ETag
+    if (S_ISDIR(entry.status.st_mode) && !watch(key)) {
+        reject(key, generation, true);
+        return;
+    }
+
+    insert(key, entry, generation);
+    return;
+}
+
+void MetadataCache::add_missing(const string &path) noexcept {
+    string key;
+    struct file entry;
+
+    // Disabled cache or path which is never cached
+    if (m_inotify_fd < 0 || !get_key(path, key) || key == "/" || is_rejected(key))
+        return;
+
+    unsigned long generation = m_generation.load();
+    if (!watch_parents(key)) {
+        reject(key, generation, true);
+        return;
+    }
+
+    // File could have been created before its directory was watched
+    entry.exists = false;
+    entry.cacheable = true;
+    if (lstat((m_root + key).c_str(), &entry.status) == 0) {
+        // Dangling symbolic link could get its target anywhere
+        if (S_ISLNK(entry.status.st_mode))
+            reject(key, generation, false);
+        return;
+    }
+    if (errno != ENOENT)
+        return;
+
+    // Directory reached through symbolic link is not the one which is watched
+    if (!is_real_path(key.substr(0, max<size_t>(key.rfind('/'), 1)))) {
+        reject(key, generation, false);
+        return;
+    }
+
+    insert(key, entry, generation);
+    return;
+}
+
+bool MetadataCache::get_key(const string &path, string &key) noexcept {
+    if (path.empty() || path.front() != '/')
+        return false;
+
+    // Reject empty, '.' and '..' components, but allow trailing '/'
+    for (size_t start = 1, end = 0; start < path.length(); start = end + 1) {
+        end = path.find('/', start);
+        if (end == string::npos)
+            end = path.length();
+        if (end == start || path.compare(start, end - start, ".") == 0
+                || path.compare(start, end - start, "..") == 0)
+            return false;
+    }
+
+    key = path;
+    if (key.length() > 1 && key.back() == '/')
+        key.pop_back();
+    return true;
+}
+
+bool MetadataCache::is_real_path(const string &key) const noexcept {
+    string path = (key == "/") ? m_root : m_root + key;
+    char *real_path = realpath(path.c_str(), nullptr);
+    bool is_real = false;
+
+    if (real_path == nullptr)
+        return false;
+    is_real = path == real_path;
+    free(real_path);
+
+    return is_real;
+}
+
+bool MetadataCache::is_rejected(const string &key) noexcept {
+    struct shard &entries_shard = get_shard(key);
+    lock_guard<mutex> lock(entries_shard.lock);
+    auto entry = entries_shard.entries.find(key);
+
+    if (entry == entries_shard.entries.end() || entry->second.cacheable)
+        return false;
+
+    // Watches may be available again
+    if (entry->second.retry != 0 && time(nullptr) >= entry->second.retry) {
+        entries_shard.entries.erase(entry);
+        return false;
+    }
+
+    return true;
+}
+
+void MetadataCache::reject(const string &key, const unsigned long &generation, const bool &retry) noexcept {
+    struct file entry;
+
+    entry.exists = false;
+    entry.cacheable = false;
+    entry.retry = retry ? time(nullptr) + MetadataCache::retry_time : 0;
+    insert(key, entry, generation);
+
+    return;
+}
+
+struct MetadataCache::shard& MetadataCache::get_shard(const string &key) noexcept {
+    return m_shards[hash<string>{}(key) % MetadataCache::shard_count];
+}
+
+bool MetadataCache::watch(const string &directory) noexcept {
+    lock_guard<mutex> lock(m_watches_lock);
+
+    if (m_directories.count(directory) > 0)
+        return true;
+
+    // Watch limit may be exhausted, then files in this directory are not cached, symbolic link is not followed,
+    // so its target is never watched under another path
+    string path = (directory == "/") ? m_root : m_root + directory;
+    int wd = inotify_add_watch(m_inotify_fd, path.c_str(), IN_MODIFY | IN_ATTRIB | IN_CREATE | IN_DELETE
+            | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR | IN_DONT_FOLLOW);
+    if (wd < 0)
+        return false;
+
+    // The same directory could be watched under another path, keep only the latest one
+    auto watched = m_watches.find(wd);
+    if (watched != m_watches.end())
+        m_directories.erase(watched->second);
+    m_watches[wd] = directory;
+    m_directories[directory] = wd;
+    return true;
+}
+
+bool MetadataCache::watch_parents(const string &key) noexcept {
+    if (!watch("/"))
+        return false;
+
+    for (size_t pos = key.find('/', 1); pos != string::npos; pos = key.find('/', pos + 1))
+        if (!watch(key.substr(0, pos)))
+            return false;
+
+    return true;
+}
+
+void MetadataCache::insert(const string &key, const struct file &entry, const unsigned long &generation) noexcept {
+    struct shard &entries_shard = get_shard(key);
+    lock_guard<mutex> lock(entries_shard.lock);
+
+    // Event processed meanwhile may be about this file
+    if (m_generation.load() != generation)
+        return;
+
+    // Make space for new entry
+    if (m_shard_max_entries > 0 && entries_shard.entries.size() >= m_shard_max_entries
+            && entries_shard.entries.count(key) == 0)
+        entries_shard.entries.erase(entries_shard.entries.begin());
+
+    entries_shard.entries[key] = entry;
+    return;
+}
+
+void MetadataCache::erase(const string &key) noexcept {
+    struct shard &entries_shard = get_shard(key);
+    lock_guard<mutex> lock(entries_shard.lock);
+    entries_shard.entries.erase(key);
+    return;
+}
+
+void MetadataCache::erase_all(const string &directory) noexcept {
+    string prefix = (directory == "/") ? directory : directory + "/";
+
+    for (auto &entries_shard : m_shards) {
+        lock_guard<mutex> lock(entries_shard.lock);
+        for (auto entry = entries_shard.entries.begin(); entry != entries_shard.entries.end();) {
+            if (directory.empty() || entry->first == directory || entry->first.compare(0, prefix.length(), prefix) == 0)
+                entry = entries_shard.entries.erase(entry);
+            else
+                ++entry;
+        }
+    }
+
+    return;
+}
+
+void MetadataCache::watch_events() noexcept {
+    alignas(struct inotify_event) char buffer[64 * (sizeof(struct inotify_event) + NAME_MAX + 1)];
+    struct pollfd fds[2] = {{m_inotify_fd, POLLIN, 0}, {m_stop_fd, POLLIN, 0}};
+    ssize_t length = 0;
+
+    for (;;) {
+        if (poll(fds, 2, -1) < 0 && errno != EINTR)
+            return;
+        if (fds[1].revents != 0)
+            return;
+
+        // Read all queued events, entries are removed before any worker can add them again
+        while ((length = read(m_inotify_fd, buffer, sizeof(buffer))) > 0) {
+            m_generation.fetch_add(1);
+            for (char *pos = buffer; pos < buffer + length;) {
+                auto event = reinterpret_cast<struct inotify_event*>(pos);
+                handle_event(*event);
+                pos += sizeof(struct inotify_event) + event->len;
+            }
+        }
+    }
+}
+
+void MetadataCache::handle_event(const struct inotify_event &event) noexcept {
+    string directory;
+
+    // Some events were lost, nothing can be trusted
+    if (event.mask & IN_Q_OVERFLOW) {
+        erase_all("");
+        return;
+    }
+
+    {
+        lock_guard<mutex> lock(m_watches_lock);
+        auto watched = m_watches.find(event.wd);
+        if (watched == m_watches.end())
+            return;
+        directory = watched->second;
+
+        // Directory is no longer watched
+        if (event.mask & IN_IGNORED) {
+            auto watched_directory = m_directories.find(directory);
+            if (watched_directory != m_directories.end() && watched_directory->second == event.wd)
+                m_directories.erase(watched_directory);
+            m_watches.erase(watched);
+        }
+    }
+
+    // Moved directory would still be watched under its old path
+    if (event.mask & IN_MOVE_SELF)
+        inotify_rm_watch(m_inotify_fd, event.wd);
+
+    // Event about watched directory itself
+    if (event.len == 0 || event.name[0] == '\0') {
+        if (event.mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF))
+            erase_all(directory);
+        else
+            erase(directory);
+        return;
+    }
+
+    string key = (directory == "/") ? directory + event.name : directory + "/" + event.name;
+
+    // Contents of file changed
+    if ((event.mask & (IN_MODIFY | IN_ATTRIB)) && !(event.mask & IN_ISDIR)) {
+        erase(key);
+        return;
+    }
+
+    // Created, deleted or renamed file may be directory (or link to it) with cached files, directory itself
+    // changed too
+    erase_all(key);
+    erase(directory);
+    return;
+}
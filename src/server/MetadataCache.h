@@ -0,0 +1,195 @@
+//
+// Created by satopja2 on 17.10.26.
+//
+
+#ifndef EIRSERVER_METADATA_CACHE_H
+#define EIRSERVER_METADATA_CACHE_H
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <ctime>
+#include <unordered_map>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#include "FileDescriptor.h"
+
+using namespace std;
+
+/**
+ * Class storing status of requested files, so requests of unchanged files do not need any metadata syscall.
+ * @note Entries are added lazily when file is opened for the first time and removed when inotify reports change
+ * in directory of the file. Watcher thread (m_watcher) reads inotify events. If inotify is not available or watch
+ * limit is exhausted, files which cannot be watched are simply not cached. Paths leading through symbolic
+ * links are not cached either. Such paths are remembered as rejected, so they are not checked again on every
+ * request, until inotify reports change on the way to them or, if watch could not be added, until retry_time
+ * passes.
+ * @note Cache is shared by all workers, so entries are split into shards by hash of their path, each guarded by
+ * its own mutex.
+ */
+class MetadataCache {
+    public:
+        /**
+         * Initializes inotify and starts watcher thread if cache is enabled.
+         * @param[in] root Root directory of served files.
+         * @param[in] enabled Whether metadata should be cached.
+         * @param[in] max_entries Maximum number of cache entries (0 means unlimited).
+         */
+        MetadataCache(const string &root, const bool &enabled, const size_t &max_entries);
+        /**
+         * Stops watcher thread and closes inotify instance.
+         */
+        ~MetadataCache();
+        /**
+         * Searches cache for status of file.
+         * @param[in] path %Path of file from HTTP request.
+         * @param[out] status Status of file, if it exists.
+         * @param[out] exists Whether file exists.
+         * @return true if file was found in cache, false otherwise.
+         */
+        bool find_file(const string &path, struct stat &status, bool &exists) noexcept;
+        /**
+         * Starts watching directory of opened file and adds its status to cache.
+         * @param[in] path %Path of file from HTTP request.
+         * @param[in] file Open file.
+         * @note Status is read again after watch is added, so no change of file can be missed.
+         */
+        void add_file(const string &path, const FileDescriptor &file) noexcept;
+        /**
+         * Starts watching directory of nonexistent file and remembers that file does not exist.
+         * @param[in] path %Path of file from HTTP request.
+         */
+        void add_missing(const string &path) noexcept;
+    private:
+        /**
+         * Struct storing one cache entry.
+         */
+        struct file {
+            /** Member holding whether file exists. */
+            bool exists;
+            /** Member holding whether status may be used, otherwise path was rejected and is never cached. */
+            bool cacheable;
+            /** Member holding time after which rejected path may be added again (0 waits for inotify event). */
+            time_t retry = 0;
+            /** Member holding status of existing file. */
+            struct stat status;
+        };
+        /**
+         * Struct storing one part of cache entries.
+         */
+        struct shard {
+            /** Member guarding entries of shard. */
+            mutex lock;
+            /** Member map storing cache entries of shard. */
+            unordered_map<string, struct file> entries;
+        };
+        /** Static member holding number of cache shards. */
+        static const size_t shard_count = 16;
+        /** Static member holding for how many seconds is path which could not be watched not added again. */
+        static const time_t retry_time = 60;
+        /** Member array storing all cache entries split into shards. */
+        array<struct shard, shard_count> m_shards;
+        /** Member holding absolute path of root directory. */
+        string m_root;
+        /** Member holding maximum number of entries in one shard (0 means unlimited). */
+        size_t m_shard_max_entries;
+        /** Member holding inotify instance file descriptor (-1 if cache is disabled). */
+        int m_inotify_fd;
+        /** Member holding file descriptor which becomes readable when watcher thread should stop. */
+        int m_stop_fd;
+        /** Member guarding m_watches. */
+        mutex m_watches_lock;
+        /** Member map holding watched directories by their watch descriptor. */
+        unordered_map<int, string> m_watches;
+        /** Member map holding watch descriptors by watched directory. */
+        unordered_map<string, int> m_directories;
+        /**
+         * Member counting processed inotify events. Entry is added only if no event was processed while its
+         * status was being read.
+         */
+        atomic<unsigned long> m_generation;
+        /** Member holding watcher thread. */
+        thread m_watcher;
+        /**
+         * Gets cache key of HTTP path. Only paths without '//', '.' and '..' components are cached, so
+         * every file has exactly one key and keys of files in directory start with key of that directory.
+         * @param[in] path %Path of file from HTTP request.
+         * @param[out] key %Path without trailing '/' (except of root directory '/').
+         * @return true if path may be cached, false otherwise.
+         */
+        static bool get_key(const string &path, string &key) noexcept;
+        /**
+         * Gets shard in which cache entry for given key belongs.
+         * @param[in] key Cache key of file.
+         * @return Reference to shard of cache entry.
+         */
+        struct shard& get_shard(const string &key) noexcept;
+        /**
+         * Checks if path was rejected, so it should not be added again. Removes rejection whose retry time passed.
+         * @param[in] key Cache key of file.
+         * @return true if path was rejected, false otherwise.
+         */
+        bool is_rejected(const string &key) noexcept;
+        /**
+         * Remembers path which cannot be cached, unless any inotify event was processed since generation was read.
+         * @param[in] key Cache key of file.
+         * @param[in] generation Value of m_generation before path was checked.
+         * @param[in] retry Whether path may be added again after retry_time, otherwise only inotify event about
+         * directory on the way to it removes rejection.
+         */
+        void reject(const string &key, const unsigned long &generation, const bool &retry) noexcept;
+        /**
+         * Checks if no component of path is symbolic link. Only such paths are cached, because inotify watches
+         * directories on the way to file, not directories in which targets of symbolic links are.
+         * @param[in] key Cache key of existing file or directory.
+         * @return true if path under root directory is its real path, false otherwise.
+         */
+        bool is_real_path(const string &key) const noexcept;
+        /**
+         * Starts watching directory unless it is already watched.
+         * @param[in] directory Cache key of directory.
+         * @return true if directory is watched, false otherwise (for example if watch limit is exhausted or
+         * directory is symbolic link).
+         */
+        bool watch(const string &directory) noexcept;
+        /**
+         * Starts watching all directories on the way from root directory to file, so renaming any of them
+         * removes cache entry of file.
+         * @param[in] key Cache key of file.
+         * @return true if all directories are watched, false otherwise.
+         */
+        bool watch_parents(const string &key) noexcept;
+        /**
+         * Adds entry to cache unless any inotify event was processed since generation was read.
+         * @param[in] key Cache key of file.
+         * @param[in] entry Cache entry.
+         * @param[in] generation Value of m_generation before status of file was read.
+         */
+        void insert(const string &key, const struct file &entry, const unsigned long &generation) noexcept;
+        /**
+         * Removes cache entry of file.
+         * @param[in] key Cache key of file.
+         */
+        void erase(const string &key) noexcept;
+        /**
+         * Removes cache entries of all files in directory and its subdirectories.
+         * @param[in] directory Cache key of directory (empty removes all entries).
+         */
+        void erase_all(const string &directory) noexcept;
+        /**
+         * Runs in watcher thread, reads inotify events and removes entries of changed files until m_stop_fd
+         * becomes readable.
+         */
+        void watch_events() noexcept;
+        /**
+         * Removes cache entries affected by one inotify event.
+         * @param[in] event Inotify event.
+         */
+        void handle_event(const struct inotify_event &event) noexcept;
+};
+
+
+#endif //EIRSERVER_METADATA_CACHE_H
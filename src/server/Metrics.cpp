@@ -0,0 +1,173 @@
+//
+// Created by satopja2 on 17.10.26.
+//
+
+#include <algorithm>
+
+#include "Metrics.h"
+
+const char *Metrics::codes[Metrics::codes_count] = {HttpConstants::CODE_OK, HttpConstants::CODE_PARTIAL_CONTENT,
+        HttpConstants::CODE_NOT_MODIFIED, HttpConstants::CODE_BAD_REQUEST, HttpConstants::CODE_NOT_FOUND,
+        HttpConstants::CODE_REQUEST_TIMEOUT, HttpConstants::CODE_RANGE_NOT_SATISFIABLE,
+        HttpConstants::CODE_HEADERS_TOO_LARGE, HttpConstants::CODE_INTERNAL_ERROR, HttpConstants::CODE_NOT_IMPLEMENTED,
+        HttpConstants::CODE_HTTP_VERSION, "other"};
+
+const char *Metrics::methods[Metrics::methods_count] = {"GET", "HEAD", "unknown", "invalid"};
+
+const char *Metrics::phase_names[Metrics::phases_count] = {"parse", "generate", "send"};
+
+void Metrics::counters::count_request(const HttpConstants::http_methods &method, const string &code) noexcept {
+    size_t code_index = 0;
+
+    // Unknown codes share the last counter
+    while (code_index < Metrics::codes_count - 1 && code != Metrics::codes[code_index])
+        code_index++;
+    add(m_requests[method][code_index], uint64_t(1));
+
+    return;
+}
+
+void Metrics::counters::count_cache(const Cache::cache_status &status) noexcept {
+    add(m_cache_results[status], uint64_t(1));
+    return;
+}
+
+void Metrics::counters::count_bytes(const size_t &bytes) noexcept {
+    add(m_bytes, uint64_t(bytes));
+    return;
+}
+
+void Metrics::counters::count_connection(const int &change) noexcept {
+    add(m_connections, int64_t(change));
+    return;
+}
+
+void Metrics::counters::record_time(const phases &phase, const chrono::nanoseconds &duration) noexcept {
+    uint64_t microseconds = max(chrono::duration_cast<chrono::microseconds>(duration).count(), 0L);
+
+    add(m_times[phase].buckets[Metrics::get_bucket(microseconds)], uint64_t(1));
+    add(m_times[phase].sum, microseconds);
+
+    return;
+}
+
+Metrics::counters& Metrics::add_counters() {
+    lock_guard<mutex> lock(m_counters_lock);
+    m_counters.push_back(make_unique<counters>());
+    return *m_counters.back();
+}
+
+string Metrics::render() const noexcept {
+    uint64_t requests[Metrics::methods_count][Metrics::codes_count] = {}, cache_results[4] = {}, bytes = 0;
+    uint64_t times[Metrics::phases_count][Metrics::buckets_count + 1] = {}, sums[Metrics::phases_count] = {};
+    uint64_t cumulative = 0;
+    int64_t connections = 0;
+    string body;
+
+    // Sum counters of all threads, they keep counting meanwhile
+    {
+        lock_guard<mutex> lock(m_counters_lock);
+        for (const auto &thread_counters : m_counters) {
+            for (size_t method = 0; method < Metrics::methods_count; ++method)
+                for (size_t code = 0; code < Metrics::codes_count; ++code)
+                    requests[method][code] += thread_counters->m_requests[method][code].load(memory_order_relaxed);
+            for (size_t status = 0; status < 4; ++status)
+                cache_results[status] += thread_counters->m_cache_results[status].load(memory_order_relaxed);
+            bytes += thread_counters->m_bytes.load(memory_order_relaxed);
+            connections += thread_counters->m_connections.load(memory_order_relaxed);
+            for (size_t phase = 0; phase < Metrics::phases_count; ++phase) {
+                for (size_t bucket = 0; bucket <= Metrics::buckets_count; ++bucket)
+                    times[phase][bucket] += thread_counters->m_times[phase].buckets[bucket].load(memory_order_relaxed);
+                sums[phase] += thread_counters->m_times[phase].sum.load(memory_order_relaxed);
+            }
+        }
+    }
+
+    append_header("eirserver_requests_total", "counter", "Handled HTTP requests by method and response code.", body);
+    for (size_t method = 0; method < Metrics::methods_count; ++method) {
+        for (size_t code = 0; code < Metrics::codes_count; ++code) {
+            if (requests[method][code] == 0)
+                continue;
+            body += "eirserver_requests_total{method=\"" + string(Metrics::methods[method]) + "\",code=\""
+                    + string(Metrics::codes[code], code == Metrics::codes_count - 1 ? 5 : 3) + "\"} "
+                    + to_string(requests[method][code]) + "\n";
+        }
+    }
+
+    append_header("eirserver_sent_bytes_total", "counter", "Bytes sent to clients.", body);
+    body += "eirserver_sent_bytes_total " + to_string(bytes) + "\n";
+
+    append_header("eirserver_connections", "gauge", "Open client connections.", body);
+    body += "eirserver_connections " + to_string(connections) + "\n";
+
+    append_header("eirserver_cache_checks_total", "counter", "Results of ETag cache checks.", body);
+    body += "eirserver_cache_checks_total{result=\"hit\"} " + to_string(cache_results[Cache::OK]) + "\n";
+    body += "eirserver_cache_checks_total{result=\"miss\"} " + to_string(cache_results[Cache::NOT_FOUND]) + "\n";
+    body += "eirserver_cache_checks_total{result=\"expired\"} " + to_string(cache_results[Cache::EXPIRED]) + "\n";
+    body += "eirserver_cache_checks_total{result=\"error\"} " + to_string(cache_results[Cache::ERROR]) + "\n";
+
+    append_header("eirserver_cache_bytes", "gauge", "Size of data held in memory caches.", body);
+    body += "eirserver_cache_bytes{cache=\"content\"} " + to_string(m_content_cache->get_used_size()) + "\n";
+    body += "eirserver_cache_bytes{cache=\"compression\"} " + to_string(m_compression_cache->get_used_size()) + "\n";
+    body += "eirserver_cache_bytes{cache=\"response\"} " + to_string(m_response_cache->get_used_size()) + "\n";
+
+    append_header("eirserver_cache_entries", "gauge", "Entries held in memory caches and open files.", body);
+    body += "eirserver_cache_entries{cache=\"content\"} " + to_string(m_content_cache->get_entries_count()) + "\n";
+    body += "eirserver_cache_entries{cache=\"compression\"} " + to_string(m_compression_cache->get_entries_count())
+            + "\n";
+    body += "eirserver_cache_entries{cache=\"response\"} " + to_string(m_response_cache->get_entries_count()) + "\n";
+    body += "eirserver_cache_entries{cache=\"descriptor\"} " + to_string(m_descriptor_cache->get_entries_count())
+            + "\n";
+
+    // Buckets are cumulative in Prometheus, bounds and sum are in seconds
+    append_header("eirserver_phase_duration_seconds", "histogram", "Duration of request handling phases.", body);
+    for (size_t phase = 0; phase < Metrics::phases_count; ++phase) {
+        string labels = "{phase=\"" + string(Metrics::phase_names[phase]) + "\",le=\"";
+        cumulative = 0;
+        for (size_t bucket = 0; bucket < Metrics::buckets_count; ++bucket) {
+            cumulative += times[phase][bucket];
+            body += "eirserver_phase_duration_seconds_bucket" + labels
+                    + to_string(get_bucket_bound(bucket) / 1000000.0) + "\"} " + to_string(cumulative) + "\n";
+        }
+        cumulative += times[phase][Metrics::buckets_count];
+        body += "eirserver_phase_duration_seconds_bucket" + labels + "+Inf\"} " + to_string(cumulative) + "\n";
+        body += "eirserver_phase_duration_seconds_sum{phase=\"" + string(Metrics::phase_names[phase]) + "\"} "
+                + to_string(sums[phase] / 1000000.0) + "\n";
+        body += "eirserver_phase_duration_seconds_count{phase=\"" + string(Metrics::phase_names[phase]) + "\"} "
+                + to_string(cumulative) + "\n";
+    }
+
+    return body;
+}
+
+size_t Metrics::get_bucket(const uint64_t &microseconds) noexcept {
+    uint64_t value = 0;
+    size_t power = 0, bucket = 0;
+
+    // The first four buckets are one microsecond wide
+    if (microseconds <= 4)
+        return microseconds == 0 ? 0 : microseconds - 1;
+
+    // Power of two of value and its two following bits choose the bucket
+    value = microseconds - 1;
+    power = 63 - __builtin_clzll(value);
+    bucket = 4 + (power - 2) * 4 + ((value >> (power - 2)) & 3);
+
+    return min(bucket, Metrics::buckets_count);
+}
+
+uint64_t Metrics::get_bucket_bound(const size_t &bucket) noexcept {
+    size_t power = 0;
+
+    if (bucket < 4)
+        return bucket + 1;
+
+    power = 2 + (bucket - 4) / 4;
+    return (uint64_t(1) << power) + ((bucket - 4) % 4 + 1) * (uint64_t(1) << (power - 2));
+}
+
+void Metrics::append_header(const string &name, const string &type, const string &help, string &body) noexcept {
+    body += "# HELP " + name + " " + help + "\n";
+    body += "# TYPE " + name + " " + type + "\n";
+    return;
+}
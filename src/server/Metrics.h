@@ -0,0 +1,181 @@
+//
+// Created by satopja2 on 17.10.26.
+//
+
+#ifndef EIRSERVER_METRICS_H
+#define EIRSERVER_METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../http/HttpConstants.h"
+#include "Cache.h"
+#include "ContentCache.h"
+#include "DescriptorCache.h"
+
+using namespace std;
+
+/**
+ * Class collecting server metrics and exposing them in Prometheus text format at
+ * \ref MetricsAddress "metrics_address".
+ * @note Every worker thread counts into its own counters, which only it writes, so counting needs no lock and no
+ * atomic read-modify-write. Counters of all threads are summed only when metrics are requested.
+ */
+class Metrics {
+    public:
+        /**
+         * Enum holding measured phases of request handling.
+         */
+        enum phases {
+            /** Parsing of request head. */
+            PHASE_PARSE,
+            /** Choosing and generating response after request was parsed. */
+            PHASE_GENERATE,
+            /** Sending of queued responses until socket accepted all of them. */
+            PHASE_SEND
+        };
+        /** Static member holding number of measured phases. */
+        static constexpr size_t phases_count = 3;
+        /** Static member holding number of latency histogram buckets (without +Inf). */
+        static constexpr size_t buckets_count = 96;
+        /** Static member holding number of counted response codes (the last one counts unknown codes). */
+        static constexpr size_t codes_count = 12;
+        /** Static member holding number of counted methods (all HttpConstants::http_methods). */
+        static constexpr size_t methods_count = 4;
+        /**
+         * Class holding counters of one thread.
+         * @note Counters are written only by their thread with relaxed load and store, reader summing them may see
+         * slightly old values, but never torn ones. Counters are aligned to cache line, so threads never write
+         * to the same line.
+         */
+        class alignas(64) counters {
+            public:
+                /**
+                 * Counts handled request.
+                 * @param[in] method Method of request.
+                 * @param[in] code Response code (example: "200 Ok").
+                 */
+                void count_request(const HttpConstants::http_methods &method, const string &code) noexcept;
+                /**
+                 * Counts result of Cache::check_file().
+                 * @param[in] status Result of check.
+                 */
+                void count_cache(const Cache::cache_status &status) noexcept;
+                /**
+                 * Counts bytes sent to clients.
+                 * @param[in] bytes Number of sent bytes.
+                 */
+                void count_bytes(const size_t &bytes) noexcept;
+                /**
+                 * Counts opened or closed connection.
+                 * @param[in] change 1 for opened connection, -1 for closed connection.
+                 */
+                void count_connection(const int &change) noexcept;
+                /**
+                 * Records duration of phase to its latency histogram.
+                 * @param[in] phase Measured phase.
+                 * @param[in] duration Duration of phase.
+                 */
+                void record_time(const phases &phase, const chrono::nanoseconds &duration) noexcept;
+            private:
+                friend class Metrics;
+                /**
+                 * Struct holding latency histogram of one phase.
+                 */
+                struct histogram {
+                    /** Member holding counts of durations by bucket, the last one counts durations over all bounds. */
+                    atomic<uint64_t> buckets[buckets_count + 1] = {};
+                    /** Member holding sum of all durations in microseconds. */
+                    atomic<uint64_t> sum = 0;
+                };
+                /** Member holding counts of requests by method and response code. */
+                atomic<uint64_t> m_requests[methods_count][codes_count] = {};
+                /** Member holding counts of Cache::check_file() results by Cache::cache_status. */
+                atomic<uint64_t> m_cache_results[4] = {};
+                /** Member holding number of bytes sent to clients. */
+                atomic<uint64_t> m_bytes = 0;
+                /** Member holding number of open connections. */
+                atomic<int64_t> m_connections = 0;
+                /** Member holding latency histograms by phase. */
+                struct histogram m_times[phases_count];
+                /**
+                 * Adds value to counter written only by this thread.
+                 * @param[in,out] counter Counter.
+                 * @param[in] value Added value.
+                 */
+                template <typename T>
+                static void add(atomic<T> &counter, const T &value) noexcept {
+                    counter.store(counter.load(memory_order_relaxed) + value, memory_order_relaxed);
+                }
+        };
+        /**
+         * Sets caches whose occupancy is exposed.
+         * @param[in] content_cache Pointer to server file content cache.
+         * @param[in] compression_cache Pointer to server compressed file cache.
+         * @param[in] response_cache Pointer to server response cache.
+         * @param[in] descriptor_cache Pointer to server open file cache.
+         */
+        Metrics(shared_ptr<ContentCache> content_cache, shared_ptr<ContentCache> compression_cache,
+                shared_ptr<ContentCache> response_cache, shared_ptr<DescriptorCache> descriptor_cache):
+            m_content_cache(move(content_cache)), m_compression_cache(move(compression_cache)),
+            m_response_cache(move(response_cache)), m_descriptor_cache(move(descriptor_cache)) {}
+        /**
+         * Creates counters for calling thread.
+         * @return Reference to counters, valid as long as metrics exist.
+         * @throw bad_alloc If counters cannot be allocated.
+         */
+        counters& add_counters();
+        /**
+         * Sums counters of all threads and formats them with cache occupancy in Prometheus text format.
+         * @return String containing all metrics.
+         */
+        string render() const noexcept;
+    private:
+        /** Static member holding counted response codes, in order of counters. */
+        static const char *codes[codes_count];
+        /** Static member holding names of counted methods, in order of HttpConstants::http_methods. */
+        static const char *methods[methods_count];
+        /** Static member holding names of measured phases, in order of phases. */
+        static const char *phase_names[phases_count];
+        /** Member holding pointer to active file content cache. */
+        shared_ptr<ContentCache> m_content_cache;
+        /** Member holding pointer to active cache of compressed files. */
+        shared_ptr<ContentCache> m_compression_cache;
+        /** Member holding pointer to active cache of complete responses. */
+        shared_ptr<ContentCache> m_response_cache;
+        /** Member holding pointer to active open file cache. */
+        shared_ptr<DescriptorCache> m_descriptor_cache;
+        /** Member guarding m_counters while threads add their counters. */
+        mutable mutex m_counters_lock;
+        /** Member holding counters of all threads. */
+        vector<unique_ptr<counters>> m_counters;
+        /**
+         * Gets histogram bucket of duration. Buckets grow by powers of two, every power of two is split into four
+         * linear sub-buckets, so bucket bound is never more than 25 % above measured duration.
+         * @param[in] microseconds Duration in microseconds.
+         * @return Index of bucket, buckets_count if duration is over all bounds.
+         */
+        static size_t get_bucket(const uint64_t &microseconds) noexcept;
+        /**
+         * Gets upper bound of histogram bucket.
+         * @param[in] bucket Index of bucket.
+         * @return Upper bound of bucket in microseconds.
+         */
+        static uint64_t get_bucket_bound(const size_t &bucket) noexcept;
+        /**
+         * Appends HELP and TYPE lines of metric to body.
+         * @param[in] name Name of metric.
+         * @param[in] type Prometheus type of metric.
+         * @param[in] help Description of metric.
+         * @param[out] body Body of metrics, appended to given string.
+         */
+        static void append_header(const string &name, const string &type, const string &help, string &body) noexcept;
+};
+
+
+#endif //EIRSERVER_METRICS_H
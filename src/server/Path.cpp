@@ -3,9 +3,17 @@
 //
 
 #include <cerrno>
+#include <atomic>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/types.h>
+#include <sys/syscall.h>
 #include <stdexcept>
+#include <string_view>
+#include <climits>
+#ifdef SYS_openat2
+#include <linux/openat2.h>
+#endif
 
 #include "Path.h"
 
@@ -75,10 +83,118 @@ Path::Path(const string &root, const string &http) {
 
 Path& Path::operator =(const string &path) noexcept {
     m_http = path;
+    m_file = nullptr;
+    m_has_status = false;
     set_absolute();
     return *this;
 }
 
+bool Path::open_at(const int &root_fd) noexcept {
+    int fd = -1;
+    bool is_beneath_root = false;
+    // Path relative to root directory
+    string relative = "." + m_http;
+
+    m_file = nullptr;
+    m_has_status = false;
+
+#ifdef SYS_openat2
+    // Kernel refuses to resolve path outside of root directory
+    static atomic<bool> has_openat2(true);
+    if (has_openat2.load(memory_order_relaxed)) {
+        struct open_how how = {};
+        how.flags = O_RDONLY | O_NONBLOCK | O_CLOEXEC;
+        how.resolve = RESOLVE_BENEATH | RESOLVE_NO_MAGICLINKS;
+        fd = syscall(SYS_openat2, root_fd, relative.c_str(), &how, sizeof(how));
+        if (fd < 0 && errno == ENOSYS)
+            has_openat2.store(false, memory_order_relaxed);
+        is_beneath_root = fd >= 0;
+    }
+    if (fd < 0 && !has_openat2.load(memory_order_relaxed))
+#endif
+        fd = openat(root_fd, relative.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    auto file = make_shared<FileDescriptor>(fd);
+
+    // Plain openat() follows symbolic links anywhere, so opened file has to be checked
+    if (!is_beneath_root && !is_beneath(root_fd, file->get())) {
+        errno = EACCES;
+        return false;
+    }
+
+    // Get status of opened file, it is the one we will read
+    if (fstat(file->get(), &m_status) < 0)
+        return false;
+
+    // FIFO or device would block worker once it is read
+    if (!S_ISREG(m_status.st_mode) && !S_ISDIR(m_status.st_mode)) {
+        errno = EACCES;
+        return false;
+    }
+    m_file = file;
+    m_has_status = true;
+
+    return true;
+}
+
+bool Path::reopen_at(const int &root_fd) noexcept {
+    struct stat known_status = m_status;
+    bool had_status = m_has_status;
+
+    if (!open_at(root_fd))
+        return false;
+
+    // Decisions were made about known file, so it has to be the one which was opened
+    if (had_status && (m_status.st_dev != known_status.st_dev || m_status.st_ino != known_status.st_ino)) {
+        m_file = nullptr;
+        m_has_status = false;
+        errno = ESTALE;
+        return false;
+    }
+
+    return true;
+}
+
+bool Path::is_beneath(const int &root_fd, const int &fd) noexcept {
+    char root[PATH_MAX], file[PATH_MAX];
+    ssize_t root_length = 0, file_length = 0;
+
+    // Kernel knows real paths of both open files, without /proc we cannot check anything
+    root_length = readlink(("/proc/self/fd/" + to_string(root_fd)).c_str(), root, sizeof(root));
+    file_length = readlink(("/proc/self/fd/" + to_string(fd)).c_str(), file, sizeof(file));
+    if (root_length <= 0 || file_length <= 0 || root_length == sizeof(root) || file_length == sizeof(file))
+        return false;
+
+    // Root itself or anything below it, but not its sibling with longer name
+    if (file_length < root_length || string_view(file, root_length) != string_view(root, root_length))
+        return false;
+    return file_length == root_length || root[root_length - 1] == '/' || file[root_length] == '/';
+}
+
+shared_ptr<FileDescriptor> Path::get_file() const noexcept {
+    return m_file;
+}
+
+void Path::set_status(const struct stat &status) noexcept {
+    m_status = status;
+    m_has_status = true;
+    return;
+}
+
+void Path::set_file(shared_ptr<FileDescriptor> file) noexcept {
+    m_file = file;
+    return;
+}
+
+bool Path::has_status() const noexcept {
+    return m_has_status;
+}
+
+const struct stat& Path::get_file_status() const noexcept {
+    return m_status;
+}
+
 bool Path::exists() const {
     return (get_status() == 0);
 }
@@ -114,6 +230,8 @@ bool Path::is_valid() const noexcept {
     auto pos_traversal = m_http.find("/../");
     if (pos_traversal != string::npos)
         return false;
+    if (m_http.length() >= 3 && m_http.compare(m_http.length() - 3, 3, "/..") == 0)
+        return false;
 
     // Check if requested path is not empty and is absolute
     return (!m_http.empty() && m_http.front() == '/');
@@ -150,7 +268,7 @@ string Path::get_filename() const noexcept {
     auto pos_separator = m_http.find_last_of('/');
     // Invalid HTTP path
     if (pos_separator == string::npos)
-        return ""
+        return "";
 
     // No filename
     if ((pos_separator + 1) == m_http.size())
@@ -165,11 +283,15 @@ string Path::get_root() const noexcept {
 
 void Path::clear() noexcept {
     m_http.clear();
+    m_file = nullptr;
+    m_has_status = false;
     m_absolute = m_http;
     return;
 }
 
 int Path::get_status() const noexcept {
+    if (m_has_status)
+        return 0;
     return stat(m_absolute.c_str(), &m_status);
 }
 
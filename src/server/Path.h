@@ -6,9 +6,12 @@
 #define EIRSERVER_PATH_H
 
 #include <string>
+#include <memory>
 
 #include <sys/stat.h>
 
+#include "FileDescriptor.h"
+
 using namespace std;
 
 /**
@@ -81,8 +84,53 @@ class Path {
          */
         bool is_regular() const;
         /**
-         * Checks for path traversal ('/../' is not allowed anywhere in m_http), if m_http is not empty and
-         * if m_http is absolute path.
+         * Opens file in m_http relative to directory root_fd for reading and gets its status with fstat(), which
+         * is then used by exists(), is_directory() and is_regular() instead of calling stat() again. Only regular
+         * files and directories are accepted, file is opened non-blocking, so FIFO cannot block the worker.
+         * @param[in] root_fd Open root directory file descriptor.
+         * @return true if file was opened, false otherwise (errno is EACCES for rejected file).
+         * @note Path is resolved by openat2() with RESOLVE_BENEATH, so neither '..' nor symbolic link can lead
+         * out of root directory. Older kernels fall back to openat(), where is_valid() has to be checked first
+         * and opened file is rejected unless is_beneath() confirms it is in root directory.
+         * Because file is opened only once, it cannot be replaced between checking and reading it.
+         */
+        bool open_at(const int &root_fd) noexcept;
+        /**
+         * Opens file whose status was set by set_status() (for example from MetadataCache) by open_at(), so it is
+         * opened as safely as any other file, and checks it is still the same file (device and inode).
+         * @param[in] root_fd Open root directory file descriptor.
+         * @return true if the same file was opened, false otherwise (errno is ESTALE if file was replaced).
+         */
+        bool reopen_at(const int &root_fd) noexcept;
+        /**
+         * Gets file opened by open_at() (m_file).
+         * @return Pointer to open file, nullptr if file was not opened.
+         */
+        shared_ptr<FileDescriptor> get_file() const noexcept;
+        /**
+         * Sets already known status of file (m_status), which is then used instead of calling stat() as if file
+         * was opened by open_at().
+         * @param[in] status Status of file.
+         */
+        void set_status(const struct stat &status) noexcept;
+        /**
+         * Sets file already opened for path (m_file), whose status was set by set_status().
+         * @param[in] file Open file, nullptr if file is not open.
+         */
+        void set_file(shared_ptr<FileDescriptor> file) noexcept;
+        /**
+         * Checks if status of file is known from open_at() or set_status() (m_has_status).
+         * @return true if get_file_status() is valid, false otherwise.
+         */
+        bool has_status() const noexcept;
+        /**
+         * Gets status of file opened by open_at() or set by set_status() (m_status).
+         * @return Reference to struct stat of file, valid only if has_status() is true.
+         */
+        const struct stat& get_file_status() const noexcept;
+        /**
+         * Checks for path traversal ('/../' is not allowed anywhere in m_http and it cannot end with '/..'),
+         * if m_http is not empty and if m_http is absolute path.
          * @return true if path is valid, false otherwise.
          */
         bool is_valid() const noexcept;
@@ -112,7 +160,7 @@ class Path {
          */
         string get_root() const noexcept;
         /**
-         * Clears m_http and sets m_absolute to m_root. Does not clear m_root!
+         * Clears m_http, closes m_file, forgets m_status and sets m_absolute to m_root. Does not clear m_root!
          */
         void clear() noexcept;
     private:
@@ -124,11 +172,23 @@ class Path {
         string m_absolute;
         /** Member struct holding information from stat(). */
         mutable struct stat m_status;
+        /** Member holding file opened by open_at(). */
+        shared_ptr<FileDescriptor> m_file;
+        /** Member holding whether m_status is known from open_at() or set_status(). */
+        bool m_has_status = false;
         /**
-         * Calls stat() on file in m_absolute and struct stat m_status.
+         * Calls stat() on file in m_absolute and struct stat m_status. File opened by open_at() or with status
+         * set by set_status() was already checked, so its status is not read again.
          * @return Integer return value of stat()
          */
         int get_status() const noexcept;
+        /**
+         * Checks if real path of open file, as resolved by kernel, is root directory or lies beneath it.
+         * @param[in] root_fd Open root directory file descriptor.
+         * @param[in] fd Open file descriptor.
+         * @return true if file is in root directory, false otherwise or if real paths cannot be read.
+         */
+        static bool is_beneath(const int &root_fd, const int &fd) noexcept;
         /**
          * Connects m_root + m_http to m_absolute.
          */
@@ -5,9 +5,10 @@
 #include <cstring>
 #include <string>
 #include <sys/unistd.h>
-#include <sys/socket.h>
+#include <sys/eventfd.h>
 #include <csignal>
 #include <stdexcept>
+#include <thread>
 
 #include "Server.h"
 #include "../loggers/ConsoleLogger.h"
@@ -42,12 +43,13 @@ map<string, string> Server::mimes = {
         {".xhtml", "application/xhtml+xml"},
         {".xml", "application/xml"}
 };
-int Server::catched_signal = 0;
+volatile sig_atomic_t Server::catched_signal = 0;
+int Server::shutdown_fd = -1;
 
 Server::Server(const string &config) {
-    string error_message, logger_type, logger_verbosity;
-    memset(&m_server, 0, sizeof(m_server));
-    memset(&m_client, 0, sizeof(m_client));
+    string error_message, logger_type, logger_verbosity, logger_format, logger_overflow;
+    size_t logger_buffer_size = 0;
+    memset(&m_addr, 0, sizeof(m_addr));
 
     // Initialize server configuration
     try {
@@ -60,28 +62,51 @@ Server::Server(const string &config) {
     // Initialize server logger
     logger_verbosity = m_config->find_setting_val("verbosity");
     logger_type = m_config->find_setting_val("log_type");
+    logger_format = m_config->find_setting_val("log_format");
+    logger_overflow = m_config->find_setting_val("log_overflow");
+    logger_buffer_size = stoul(m_config->find_setting_val("log_buffer_size"));
     if (logger_type == "console"s)
-        m_logger = make_shared<ConsoleLogger>(logger_verbosity);
+        m_logger = make_shared<ConsoleLogger>(logger_verbosity, logger_format, logger_overflow, logger_buffer_size);
     else if (logger_type == "syslog"s)
-        m_logger = make_shared<SyslogLogger>(logger_verbosity);
+        m_logger = make_shared<SyslogLogger>(logger_verbosity, logger_overflow, logger_buffer_size);
     else {
         try {
-            m_logger = make_shared<FileLogger>(logger_verbosity, m_config->find_setting_val("log_file"));
+            m_logger = make_shared<FileLogger>(logger_verbosity, m_config->find_setting_val("log_file"),
+                    logger_format, logger_overflow, logger_buffer_size,
+                    stoll(m_config->find_setting_val("log_max_size")), stoul(m_config->find_setting_val("log_keep")),
+                    m_config->find_setting_val("log_compress") == "on");
         } catch (const runtime_error& e) {
             error_message = "Logger error: " + string(e.what());
             throw runtime_error(error_message);
         }
     }
+    m_logger->set_filters(stoul(m_config->find_setting_val("log_sample")),
+            chrono::milliseconds(stoul(m_config->find_setting_val("log_slow_time"))),
+            stoul(m_config->find_setting_val("log_rate_limit")));
 
     // Initialize server cache
-    m_cache = make_shared<Cache>(stoi(m_config->find_setting_val("cache_time")));
-
-    // Prepare server socket struct
+    m_cache = make_shared<Cache>(stoi(m_config->find_setting_val("cache_time")),
+            stoul(m_config->find_setting_val("cache_max_entries")));
+    m_content_cache = make_shared<ContentCache>(stoul(m_config->find_setting_val("content_cache_size")));
+    m_metadata_cache = make_shared<MetadataCache>(m_config->find_setting_val("root_dir"),
+            m_config->find_setting_val("metadata_cache") == "on",
+            stoul(m_config->find_setting_val("cache_max_entries")));
+    m_descriptor_cache = make_shared<DescriptorCache>(stoul(m_config->find_setting_val("fd_cache_size")));
+    m_compression_cache = make_shared<ContentCache>(stoul(m_config->find_setting_val("compression_cache_size")));
+    m_response_cache = make_shared<ContentCache>(stoul(m_config->find_setting_val("response_cache_size")));
+    m_metrics = make_shared<Metrics>(m_content_cache, m_compression_cache, m_response_cache, m_descriptor_cache);
+
+    // Prepare server socket address
     string server_ip = m_config->find_setting_val("ip");
-    m_server.addr.sin_family = AF_INET;
-    if (inet_pton(AF_INET, server_ip.c_str(), &m_server.addr.sin_addr) == 0)
+    m_addr.sin_family = AF_INET;
+    if (inet_pton(AF_INET, server_ip.c_str(), &m_addr.sin_addr) == 0)
         throw runtime_error("Config file error: ip address is invalid");
-    m_server.addr.sin_port = htons(stoi(m_config->find_setting_val("port")));
+    m_addr.sin_port = htons(stoi(m_config->find_setting_val("port")));
+
+    // Prepare shutdown notification for workers
+    Server::shutdown_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (Server::shutdown_fd < 0)
+        throw runtime_error("Unable to create shutdown notification");
 
     register_signals();
 
@@ -89,158 +114,81 @@ Server::Server(const string &config) {
 }
 
 Server::~Server() {
-    close(m_client.fd);
-    close(m_server.fd);
+    m_workers.clear();
+    close(Server::shutdown_fd);
     return;
 }
 
 bool Server::start() noexcept {
-    if (!setup())
-        return false;
-    string request;
-    string response;
-    char request_ip[INET_ADDRSTRLEN] = {0};
-    m_request = make_unique<Request>(m_config, m_cache, m_logger);
-
-    // Main control loop
-    for (;;) {
-        // Handle termination signals
-        if (Server::catched_signal) {
-            m_log_message = "Catched signal number: " + to_string(Server::catched_signal);
-            m_logger->log_message(Logger::WARNING, m_log_message);
-            return true;
-        }
-
-        // Accept client connection
-        m_client.fd = accept(m_server.fd, (struct sockaddr*)&m_client.addr, (socklen_t*)&m_client.addr_len);
-        if (m_client.fd < 0) {
-            m_log_message = "Unable to accept connections (queue may be full)";
-            m_logger->log_message(Logger::ERROR, m_log_message);
-            m_request->reset();
-            close(m_client.fd);
-            continue;
-        }
-
-        // Get client IP address
-        if (inet_ntop(AF_INET, &m_client.addr.sin_addr, request_ip, sizeof(request_ip)) == NULL)
-            strncpy(request_ip, "Invalid IP", INET_ADDRSTRLEN);
-
-        // Receive data from client
-        switch (recv_all(request)) {
-            case -1:
-                m_log_message = "Unable to receive data from client -> " + string(request_ip);
-                m_logger->log_message(Logger::ERROR, m_log_message);
-                m_request->reset();
-                close(m_client.fd);
-                continue;
-            case 0:
-                m_log_message = "Client disconnected -> " + string(request_ip);
-                m_logger->log_message(Logger::ERROR, m_log_message);
-                m_request->reset();
-                close(m_client.fd);
-                continue;
-            case 1:
-                break;
-        }
-
-        // Get response to request
-        response = m_request->handle(request, request_ip);
-
-        // Handle termination signals
-        if (Server::catched_signal) {
-            m_log_message = "Shutdown requsted";
-            m_logger->log_message(Logger::WARNING, m_log_message);
-            return true;
-        }
-
-        // Send response to client
-        if (!send_all(response)) {
-            m_log_message = "Unable to send full response to client -> " + string(request_ip);
-            m_logger->log_message(Logger::ERROR, m_log_message);
-            m_request->reset();
-            close(m_client.fd);
-            continue;
-        }
-
-        m_request->reset();
-        close(m_client.fd);
+    bool success = true;
+    vector<thread> threads;
+    unsigned int workers_count = stoi(m_config->find_setting_val("workers"));
+
+    // One worker per available core
+    if (workers_count == 0)
+        workers_count = max(thread::hardware_concurrency(), 1u);
+
+    // Setup all workers before accepting any connection
+    for (unsigned int i = 0; i < workers_count; ++i) {
+        m_workers.push_back(make_unique<Worker>(m_config, m_cache, m_content_cache, m_metadata_cache,
+                m_descriptor_cache, m_compression_cache, m_response_cache, m_logger, m_metrics, m_addr,
+                Server::shutdown_fd));
+        if (!m_workers.back()->setup())
+            return false;
     }
 
-    return true;
-}
-
-bool Server::setup() noexcept {
-    // Get server socket file descriptor
-    m_server.fd = socket(PF_INET, SOCK_STREAM, 0);
-    if (m_server.fd < 0) {
-        m_log_message = "Unable to get server socket file descriptor";
+    // Run first worker in this thread and the rest in their own threads
+    vector<char> results(workers_count, 1);
+    try {
+        for (unsigned int i = 1; i < workers_count; ++i)
+            threads.emplace_back([this, &results, i]() {
+                results[i] = m_workers[i]->run();
+                // Worker failed, shut down the rest
+                if (!results[i] && !Server::catched_signal)
+                    terminate(SIGTERM);
+            });
+    } catch (const system_error& e) {
+        m_log_message = "Unable to start worker thread";
         m_logger->log_message(Logger::ERROR, m_log_message);
-        return false;
+        terminate(SIGTERM);
+        success = false;
     }
+    results[0] = m_workers[0]->run();
 
-    // Enable reusing of socket, for example if the server crashes and starts again immediately
-    int enable = 1;
-    if (setsockopt(m_server.fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)) < 0) {
-        m_log_message = "Unable to set server socket options";
-        m_logger->log_message(Logger::ERROR, m_log_message);
-        return false;
-    }
+    // Worker failed, shut down the rest
+    if (!results[0] && !Server::catched_signal)
+        terminate(SIGTERM);
 
-    // Bind server socket to port
-    if (bind(m_server.fd, (struct sockaddr*)&m_server.addr, sizeof(m_server.addr)) < 0) {
-        m_log_message = "Unable to bind server socket to port " + m_config->find_setting_val("port");
-        m_logger->log_message(Logger::ERROR, m_log_message);
-        return false;
-    }
+    for (auto &worker_thread : threads)
+        worker_thread.join();
+    for (const auto &result : results)
+        success = success && result;
 
-    // Start listening on our port for incoming connections
-    if (listen(m_server.fd, Server::active_incoming) < 0) {
-        m_log_message = "Unable to start listening on port " + m_config->find_setting_val("port");
-        m_logger->log_message(Logger::ERROR, m_log_message);
-        return false;
-    }
+    // Handle termination signals
+    m_log_message = "Catched signal number: " + to_string(Server::catched_signal);
+    m_logger->log_message(Logger::WARNING, m_log_message);
 
-    return true;
+    return success;
 }
 
 void Server::register_signals() noexcept {
     signal(SIGTERM, Server::terminate);
+    signal(SIGUSR1, Server::rotate_logs);
+    // Client closing connection in the middle of sendfile() would otherwise kill the whole server
+    signal(SIGPIPE, SIG_IGN);
     return;
 }
 
 void Server::terminate(int signum) noexcept {
+    uint64_t value = 1;
     Server::catched_signal = signum;
+    // Level-triggered readable eventfd wakes up every worker
+    write(Server::shutdown_fd, &value, sizeof(value));
     return;
 }
 
-int Server::recv_all(string &request) noexcept {
-    int recv_val = 0;
-    char buffer[Server::recv_buffer_size];
-    request.clear();
-
-    recv_val = recv(m_client.fd, buffer, Server::recv_buffer_size, 0);
-
-    // Client disconnected or recv() error
-    if (recv_val <= 0)
-        return recv_val;
-
-    request.append(buffer, recv_val);
-
-    return 1;
-}
-
-bool Server::send_all(const string &response) noexcept {
-    int bytes_sent = 0, bytes_left = response.length();
-    const char* response_c_str = response.c_str();
-
-    // Send all data
-    while (bytes_left > 0) {
-        bytes_sent = send(m_client.fd, response_c_str + bytes_sent, bytes_left, 0);
-        if (bytes_sent == -1)
-            return false;
-        bytes_left -= bytes_sent;
-        bytes_sent += bytes_sent;
-    }
-
-    return true;
+void Server::rotate_logs(int signum) noexcept {
+    // Writer thread of logger notices request within its flush interval
+    Logger::rotate_requested = 1;
+    return;
 }
\ No newline at end of file
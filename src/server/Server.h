@@ -7,13 +7,18 @@
 
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <csignal>
 #include <memory>
 #include <map>
+#include <vector>
 
-#include "../http/Request.h"
 #include "../loggers/Logger.h"
 #include "Config.h"
 #include "Cache.h"
+#include "ContentCache.h"
+#include "MetadataCache.h"
+#include "DescriptorCache.h"
+#include "Worker.h"
 
 using namespace std;
 
@@ -23,102 +28,90 @@ using namespace std;
 class Server {
     public:
         /**
-         * Initializes server configuration (m_config), logger based on configuration (m_logger) and cache (m_cache).
-         * Registers signal handlers.
+         * Initializes server configuration (m_config), logger based on configuration (m_logger), cache (m_cache),
+         * file content cache (m_content_cache), file metadata cache (m_metadata_cache), open file cache
+         * (m_descriptor_cache), compressed file cache (m_compression_cache), response cache (m_response_cache)
+         * and metrics (m_metrics). Registers signal handlers.
          * @param[in] config %Path to config file which should eirserver use.
          * @throw runtime_error If config file contains errors or logger cannot be initialized.
          * @see Config
          * @see Logger
          * @see Cache
+         * @see ContentCache
+         * @see MetadataCache
+         * @see DescriptorCache
+         * @see Metrics
          * @see register_signals()
          */
         Server(const string &config);
         /**
-         * Closes client and server sockets.
+         * Stops all workers and closes shutdown notification file descriptor.
          */
         ~Server();
         /** Static map of all known mime types. */
         static map<string, string> mimes;
         /**
-         * Setups server socket, m_request and starts main control loop.
+         * Setups \ref Workers "workers" and runs their event loops.
          *
-         * Calls setup() which prepares the server socket. Starts main control loop which
-         * receives HTTP requests from clients, then calls HTTP request handler on them
-         * and sends full HTTP responses back to clients. If registered termination signal is catched
-         * it shuts the server down.
+         * Creates and setups one Worker for every configured worker thread, each with its own listening socket.
+         * Runs first worker in calling thread and the rest in their own threads. If registered termination signal
+         * is catched it shuts all workers down.
          *
          * It should really only return if we are shutting the server down.
-         * @return true if registered signal is catched, false if setup() failed
-         * @see Request
-         * @see Response
-         * @see setup()
-         * @see recv_all()
-         * @see send_all()
+         * @return true if registered signal is catched, false if setup of any worker failed or
+         * any worker encountered error
+         * @see Worker
          */
         bool start() noexcept;
     private:
-        /** Static member used for catching signals in main control loop. */
-        static int catched_signal;
-        /** Static member holding number of active connections which should listen() use. */
-        static const int active_incoming = 10;
-        /** Static member holding size of buffer for recv(). */
-        static const int recv_buffer_size = 4096;
-        /** Member holding pointer to current handled request. */
-        unique_ptr<Request> m_request;
+        /** Static member used for catching signals in worker event loops. */
+        static volatile sig_atomic_t catched_signal;
+        /** Static member holding file descriptor which becomes readable when termination signal is catched. */
+        static int shutdown_fd;
         /** Member holding pointer to loaded configuration. */
         shared_ptr<Config> m_config;
         /** Member holding pointer to active cache. */
         shared_ptr<Cache> m_cache;
+        /** Member holding pointer to active file content cache. */
+        shared_ptr<ContentCache> m_content_cache;
+        /** Member holding pointer to active file metadata cache. */
+        shared_ptr<MetadataCache> m_metadata_cache;
+        /** Member holding pointer to active open file cache. */
+        shared_ptr<DescriptorCache> m_descriptor_cache;
+        /** Member holding pointer to active cache of compressed files. */
+        shared_ptr<ContentCache> m_compression_cache;
+        /** Member holding pointer to active cache of complete responses. */
+        shared_ptr<ContentCache> m_response_cache;
         /** Member holding pointer to active logger. */
         shared_ptr<Logger> m_logger;
+        /** Member holding pointer to server metrics. */
+        shared_ptr<Metrics> m_metrics;
         /** Member holding current logged message. */
         string m_log_message;
-        /**
-         * Struct storing information about socket used by server.
-         */
-        struct sock {
-            /** Member holding socket file descriptor. */
-            int fd;
-            /** Member holding network address information. */
-            struct sockaddr_in addr;
-            /** Member holding size of network address information. */
-            size_t addr_len;
-        };
-        /** Member storing socket information about server. */
-        struct sock m_server;
-        /** Member storing socket information about client. */
-        struct sock m_client;
-        /**
-         * Gets server socket file descriptor, enables its reusing, binds and starts listening on it.
-         * @return Boolean if preparing the server socket was successful.
-         */
-        bool setup() noexcept;
+        /** Member holding network address on which workers listen. */
+        struct sockaddr_in m_addr;
+        /** Member holding all workers. */
+        vector<unique_ptr<Worker>> m_workers;
         /**
          * Registers signal handlers for all implemented signals.
-         * @note Currently implemented is only SIGTERM used for turning off the server
-         * with \ref Shutdown "shutdown address" configured in config file.
+         * @note Currently implemented are SIGTERM used for turning off the server
+         * with \ref Shutdown "shutdown address" configured in config file and SIGUSR1 used for rotating log file.
+         * SIGPIPE is ignored, so write to closed client socket fails with EPIPE instead of killing the server.
          */
         void register_signals() noexcept;
         /**
-         * Sets catched signal number (signum) to static member catched_signal for termination in main control loop.
+         * Sets catched signal number (signum) to static member catched_signal and notifies all workers
+         * through shutdown_fd.
          * @param[in] signum Catched signal number.
          * @see catched_signal
          */
         static void terminate(int signum) noexcept;
         /**
-         * Receives data from client socket (m_client.fd).
-         * @param[out] request Where should be the received data stored.
-         * @return -1 if recv() encountered error, 0 if client disconnected, 1 if recv() was successful
-         */
-        int recv_all(string &request) noexcept;
-        /**
-         * Sends all HTTP response data through client socket (m_client.fd) to client.
-         * @param[in] response Data to be sent.
-         * @return true if sending all data was successful, false if send() encountered error
-         * @note Because send() sometimes does not send all the data, we need to do this in a loop
-         * and make sure that everything was truly sent.
+         * Asks logger to rotate its output by setting Logger::rotate_requested.
+         * @param[in] signum Catched signal number.
+         * @see Logger::rotate_requested
          */
-        bool send_all(const string &response) noexcept;
+        static void rotate_logs(int signum) noexcept;
 };
 
 #endif //EIRSERVER_SERVER_H
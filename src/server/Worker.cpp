@@ -0,0 +1,421 @@
+//
+// Created by satopja2 on 17.10.26.
+//
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <vector>
+#include <algorithm>
+
+#include "Worker.h"
+#include "../generators/ScriptGenerator.h"
+
+Worker::Worker(shared_ptr<Config> config, shared_ptr<Cache> cache, shared_ptr<ContentCache> content_cache,
+        shared_ptr<MetadataCache> metadata_cache, shared_ptr<DescriptorCache> descriptor_cache,
+        shared_ptr<ContentCache> compression_cache, shared_ptr<ContentCache> response_cache, shared_ptr<Logger> logger,
+        shared_ptr<Metrics> metrics, const struct sockaddr_in &addr, const int &shutdown_fd) noexcept:
+    m_config(config), m_cache(cache), m_content_cache(content_cache), m_metadata_cache(metadata_cache),
+    m_descriptor_cache(descriptor_cache), m_compression_cache(compression_cache), m_response_cache(response_cache),
+    m_logger(logger), m_metrics(metrics), m_counters(nullptr), m_shutdown_fd(shutdown_fd), m_epoll_fd(-1),
+    m_spare_fd(-1), m_accept_pending(false) {
+    memset(&m_server, 0, sizeof(m_server));
+    m_server.fd = -1;
+    m_server.addr = addr;
+    m_keepalive_timeout = stoi(m_config->find_setting_val("keepalive_timeout"));
+    m_keepalive_max_requests = stoi(m_config->find_setting_val("keepalive_max_requests"));
+    m_max_header_size = stoul(m_config->find_setting_val("max_header_size"));
+    m_header_timeout = stoi(m_config->find_setting_val("header_timeout"));
+    m_send_timeout = stoi(m_config->find_setting_val("send_timeout"));
+    return;
+}
+
+Worker::~Worker() {
+    m_connections.clear();
+    if (m_epoll_fd >= 0)
+        close(m_epoll_fd);
+    if (m_server.fd >= 0)
+        close(m_server.fd);
+    if (m_spare_fd >= 0)
+        close(m_spare_fd);
+    return;
+}
+
+bool Worker::setup() noexcept {
+    // Get non-blocking server socket file descriptor
+    m_server.fd = socket(PF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_server.fd < 0) {
+        m_log_message = "Unable to get server socket file descriptor";
+        m_logger->log_message(Logger::ERROR, m_log_message);
+        return false;
+    }
+
+    // Enable reusing of socket, for example if the server crashes and starts again immediately,
+    // and binding of the same port by every worker
+    int enable = 1;
+    if (setsockopt(m_server.fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)) < 0
+            || setsockopt(m_server.fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) < 0) {
+        m_log_message = "Unable to set server socket options";
+        m_logger->log_message(Logger::ERROR, m_log_message);
+        return false;
+    }
+
+    // Bind server socket to port
+    if (bind(m_server.fd, (struct sockaddr*)&m_server.addr, sizeof(m_server.addr)) < 0) {
+        m_log_message = "Unable to bind server socket to port " + m_config->find_setting_val("port");
+        m_logger->log_message(Logger::ERROR, m_log_message);
+        return false;
+    }
+
+    // Start listening on our port for incoming connections
+    if (listen(m_server.fd, Worker::active_incoming) < 0) {
+        m_log_message = "Unable to start listening on port " + m_config->find_setting_val("port");
+        m_logger->log_message(Logger::ERROR, m_log_message);
+        return false;
+    }
+
+    // Create epoll instance and register server socket and shutdown notification in it
+    struct epoll_event server_event, shutdown_event;
+    memset(&server_event, 0, sizeof(server_event));
+    memset(&shutdown_event, 0, sizeof(shutdown_event));
+    server_event.events = EPOLLIN | EPOLLET;
+    server_event.data.ptr = &m_server;
+    shutdown_event.events = EPOLLIN;
+    shutdown_event.data.ptr = &m_shutdown_fd;
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epoll_fd < 0 || epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_server.fd, &server_event) < 0
+            || epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_shutdown_fd, &shutdown_event) < 0) {
+        m_log_message = "Unable to create epoll instance";
+        m_logger->log_message(Logger::ERROR, m_log_message);
+        return false;
+    }
+
+    // Reserve file descriptor for refusing clients once all others are used
+    m_spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    if (m_spare_fd < 0) {
+        m_log_message = "Unable to reserve spare file descriptor";
+        m_logger->log_message(Logger::ERROR, m_log_message);
+        return false;
+    }
+
+    return true;
+}
+
+bool Worker::run() noexcept {
+    int events_count = 0;
+    time_t now = 0, last_timeout_check = time(nullptr);
+    struct epoll_event events[Worker::max_events];
+    m_counters = &m_metrics->add_counters();
+    m_request = make_unique<Request>(m_config, m_cache, m_content_cache, m_metadata_cache,
+            m_descriptor_cache, m_compression_cache, m_response_cache, m_logger, m_metrics, *m_counters);
+
+    // Main event loop
+    for (;;) {
+        // Wait for events on server and client sockets
+        events_count = epoll_wait(m_epoll_fd, events, Worker::max_events, Worker::epoll_timeout);
+        if (events_count < 0) {
+            if (errno == EINTR)
+                continue;
+            m_log_message = "Unable to wait for events on sockets";
+            m_logger->log_message(Logger::ERROR, m_log_message);
+            return false;
+        }
+
+        for (int i = 0; i < events_count; ++i) {
+            // Server is shutting down
+            if (events[i].data.ptr == &m_shutdown_fd)
+                return true;
+
+            // New clients on server socket
+            if (events[i].data.ptr == &m_server) {
+                accept_all();
+                continue;
+            }
+
+            // Progress client connection, unless it was closed by earlier event of its socket or stream
+            auto connection = static_cast<Connection*>(events[i].data.ptr);
+            auto connection_itr = m_connections.find(connection->get_fd());
+            if (connection_itr == m_connections.end() || connection_itr->second.get() != connection)
+                continue;
+            handle_client(*connection, events[i].events);
+        }
+
+        // Close idle and slow connections, retry accepting clients left in queue after error, reap killed scripts
+        now = time(nullptr);
+        if (now != last_timeout_check) {
+            check_timeouts(now);
+            ScriptGenerator::reap_scripts();
+            if (m_accept_pending)
+                accept_all();
+            last_timeout_check = now;
+        }
+
+        // No event can refer to closed connections anymore
+        m_closed.clear();
+    }
+
+    return true;
+}
+
+void Worker::accept_all() noexcept {
+    int client_fd = 0;
+    struct sockaddr_in client_addr;
+    socklen_t client_addr_len = sizeof(client_addr);
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+
+    // Accept until accept() would block
+    m_accept_pending = false;
+    for (;;) {
+        client_addr_len = sizeof(client_addr);
+        client_fd = accept4(m_server.fd, (struct sockaddr*)&client_addr, &client_addr_len,
+                SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_fd < 0) {
+            // Client gave up while waiting in queue, the others are still there
+            if (errno == EINTR || errno == ECONNABORTED || errno == EPROTO)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return;
+            m_log_message = "Unable to accept connections: " + string(strerror(errno));
+            // No file descriptor is left, refuse client with spare one, so queue is not stuck
+            if ((errno == EMFILE || errno == ENFILE) && m_spare_fd >= 0) {
+                if (refuse_client()) {
+                    m_logger->log_message(Logger::ERROR, m_log_message + " (client refused)");
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    return;
+                m_log_message = "Unable to accept connections: " + string(strerror(errno));
+            }
+            // Edge-triggered socket does not report clients which are already in queue, so retry later
+            m_logger->log_message(Logger::ERROR, m_log_message);
+            m_accept_pending = true;
+            return;
+        }
+
+        // Register client socket for both reading and writing, edge-triggered events fire only on change
+        auto connection = make_unique<Connection>(client_fd, client_addr, m_max_header_size);
+        event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        event.data.ptr = connection.get();
+        if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, client_fd, &event) < 0) {
+            m_log_message = "Unable to register client -> " + string(connection->get_ip());
+            m_logger->log_message(Logger::ERROR, m_log_message);
+            continue;
+        }
+        m_connections[client_fd] = move(connection);
+        m_counters->count_connection(1);
+    }
+}
+
+bool Worker::refuse_client() noexcept {
+    int client_fd = -1, accept_errno = 0;
+
+    close(m_spare_fd);
+    client_fd = accept4(m_server.fd, nullptr, nullptr, SOCK_CLOEXEC);
+    accept_errno = errno;
+    if (client_fd >= 0)
+        close(client_fd);
+    m_spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    errno = accept_errno;
+
+    return client_fd >= 0;
+}
+
+void Worker::handle_client(Connection &connection, const uint32_t &events) noexcept {
+    bool disconnected = false;
+    Connection::io_status status = Connection::IO_DONE;
+
+    // Socket error
+    if (events & EPOLLERR) {
+        m_log_message = "Unable to receive data from client -> " + string(connection.get_ip());
+        m_logger->log_message(Logger::ERROR, m_log_message);
+        close_client(connection);
+        return;
+    }
+
+    // Remember to read new data, even while writing, because we would not be notified about them again
+    if (events & (EPOLLIN | EPOLLRDHUP))
+        connection.set_readable();
+
+    // Wait for client to close connection after our last response
+    if (connection.get_state() == Connection::LINGERING) {
+        if (connection.is_readable() && connection.discard_all() != Connection::IO_AGAIN)
+            close_client(connection);
+        return;
+    }
+
+    for (;;) {
+        // Receive data from client, but never buffer more than maximum request head size
+        if (connection.is_readable()) {
+            switch (connection.recv_all()) {
+                case Connection::IO_ERROR:
+                    m_log_message = "Unable to receive data from client -> " + string(connection.get_ip());
+                    m_logger->log_message(Logger::ERROR, m_log_message);
+                    close_client(connection);
+                    return;
+                case Connection::IO_CLOSED:
+                    // Client may have sent full requests before closing its side of connection
+                    disconnected = true;
+                    break;
+                case Connection::IO_AGAIN:
+                case Connection::IO_DONE:
+                    break;
+            }
+        }
+
+        // Get responses to all complete requests
+        if (connection.get_state() == Connection::READING) {
+            if (connection.is_keep_alive())
+                handle_requests(connection);
+            if (connection.get_state() == Connection::READING) {
+                // Client disconnected in the middle of request
+                if (disconnected && connection.has_data()) {
+                    m_log_message = "Client disconnected -> " + string(connection.get_ip());
+                    m_logger->log_message(Logger::ERROR, m_log_message);
+                }
+                // Nothing more to do on this connection
+                if (disconnected || !connection.is_keep_alive()) {
+                    if (!disconnected && (connection.has_data() || connection.is_readable())) {
+                        connection.linger();
+                        if (connection.is_readable() && connection.discard_all() != Connection::IO_AGAIN)
+                            close_client(connection);
+                    } else
+                        close_client(connection);
+                    return;
+                }
+                // Handled requests made space in full buffer for more data
+                if (connection.is_readable())
+                    continue;
+                return;
+            }
+        }
+
+        // Send responses to client
+        status = connection.send_all();
+        m_counters->count_bytes(connection.take_bytes_sent());
+        switch (status) {
+            case Connection::IO_AGAIN:
+                // Nobody would read rest of streamed body
+                if (disconnected && connection.get_stream_fd() >= 0) {
+                    m_log_message = "Client disconnected -> " + string(connection.get_ip());
+                    m_logger->log_message(Logger::ERROR, m_log_message);
+                    close_client(connection);
+                    return;
+                }
+                // Streamed body may be waiting for its data instead of socket
+                if (!watch_stream(connection))
+                    close_client(connection);
+                return;
+            case Connection::IO_ERROR:
+            case Connection::IO_CLOSED:
+                m_log_message = "Unable to send full response to client -> " + string(connection.get_ip());
+                m_logger->log_message(Logger::ERROR, m_log_message);
+                close_client(connection);
+                return;
+            case Connection::IO_DONE:
+                m_counters->record_time(Metrics::PHASE_SEND, chrono::steady_clock::now() - connection.get_send_start());
+                break;
+        }
+    }
+}
+
+void Worker::handle_requests(Connection &connection) noexcept {
+    bool keep_alive = false;
+
+    while (connection.is_keep_alive() && connection.has_request()) {
+        // Connection may stay open unless it is disabled or this is the last allowed request
+        keep_alive = m_keepalive_timeout > 0 && (m_keepalive_max_requests == 0
+                || connection.get_requests_count() + 1 < m_keepalive_max_requests);
+
+        // Get response to request
+        auto response = m_request->handle(connection.get_request(), connection.get_ip(), keep_alive);
+        connection.add_response(move(response), m_request->is_keep_alive());
+        connection.consume_request();
+        m_request->reset();
+    }
+
+    // Request head does not fit to buffer
+    if (connection.is_keep_alive() && connection.is_request_too_large()) {
+        connection.add_response(m_request->handle_error(HttpConstants::CODE_HEADERS_TOO_LARGE,
+                connection.get_ip()), false);
+        m_request->reset();
+    }
+
+    return;
+}
+
+void Worker::check_timeouts(const time_t &now) noexcept {
+    vector<Connection*> idle, slow;
+
+    // Find connections waiting for next request, sending request or not reading response for too long
+    for (const auto &connection : m_connections) {
+        if (connection.second->get_state() == Connection::LINGERING
+                && (now - connection.second->get_last_activity()) >= Worker::linger_timeout)
+            idle.push_back(connection.second.get());
+        // Client does not read responses
+        if (connection.second->get_state() == Connection::WRITING
+                && (now - connection.second->get_last_activity()) >= m_send_timeout)
+            idle.push_back(connection.second.get());
+        if (connection.second->get_state() != Connection::READING || !connection.second->is_keep_alive())
+            continue;
+        if (!connection.second->has_data()
+                && (now - connection.second->get_last_activity()) >= max(m_keepalive_timeout, 1))
+            idle.push_back(connection.second.get());
+        else if (connection.second->has_data() && (now - connection.second->get_request_start()) >= m_header_timeout)
+            slow.push_back(connection.second.get());
+    }
+
+    for (auto connection : idle) {
+        // Hung script would otherwise only look like slow client
+        if (connection->get_state() == Connection::WRITING && connection->is_waiting_for_stream()) {
+            m_log_message = "Response body was not generated in time -> " + string(connection->get_ip());
+            m_logger->log_message(Logger::ERROR, m_log_message);
+        }
+        close_client(*connection);
+    }
+
+    // Tell slow clients why we are closing connection
+    for (auto connection : slow) {
+        connection->add_response(m_request->handle_error(HttpConstants::CODE_REQUEST_TIMEOUT,
+                connection->get_ip()), false);
+        m_request->reset();
+        handle_client(*connection, 0);
+    }
+
+    return;
+}
+
+bool Worker::watch_stream(Connection &connection) noexcept {
+    int stream_fd = connection.get_stream_fd();
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+
+    if (stream_fd < 0)
+        return true;
+
+    // Stream is registered until it is closed, closing removes it from epoll instance
+    event.events = EPOLLIN | EPOLLET;
+    event.data.ptr = &connection;
+    if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, stream_fd, &event) < 0 && errno != EEXIST) {
+        m_log_message = "Unable to wait for response body of client -> " + string(connection.get_ip());
+        m_logger->log_message(Logger::ERROR, m_log_message);
+        return false;
+    }
+
+    return true;
+}
+
+void Worker::close_client(Connection &connection) noexcept {
+    // Socket is closed only after current events are handled, so it has to be removed from epoll instance now
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, connection.get_fd(), nullptr);
+    auto connection_itr = m_connections.find(connection.get_fd());
+    if (connection_itr == m_connections.end())
+        return;
+    m_closed.push_back(move(connection_itr->second));
+    m_connections.erase(connection_itr);
+    m_counters->count_connection(-1);
+    return;
+}
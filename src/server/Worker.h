@@ -0,0 +1,216 @@
+//
+// Created by satopja2 on 17.10.26.
+//
+
+#ifndef EIRSERVER_WORKER_H
+#define EIRSERVER_WORKER_H
+
+#include <netinet/in.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../http/Request.h"
+#include "../loggers/Logger.h"
+#include "Config.h"
+#include "Cache.h"
+#include "ContentCache.h"
+#include "MetadataCache.h"
+#include "DescriptorCache.h"
+#include "Metrics.h"
+#include "Connection.h"
+
+using namespace std;
+
+/**
+ * Class running one event loop with its own listening socket, client connections and request handler.
+ * @note Every worker binds its own socket with SO_REUSEPORT, so the kernel distributes incoming
+ * connections between workers and no state needs to be shared between them except Config, Cache, ContentCache,
+ * MetadataCache, DescriptorCache, Logger and Metrics, where every worker counts only into its own counters.
+ */
+class Worker {
+    public:
+        /**
+         * Sets pointers to shared configuration (m_config), cache (m_cache), file content cache (m_content_cache),
+         * file metadata cache (m_metadata_cache), open file cache (m_descriptor_cache), compressed file cache
+         * (m_compression_cache), response cache (m_response_cache), logger (m_logger) and metrics (m_metrics),
+         * address on which worker should listen (m_server.addr) and file descriptor signalling shutdown
+         * (m_shutdown_fd).
+         * @param[in] config Pointer to server configuration.
+         * @param[in] cache Pointer to server cache.
+         * @param[in] content_cache Pointer to server file content cache.
+         * @param[in] metadata_cache Pointer to server file metadata cache.
+         * @param[in] descriptor_cache Pointer to server open file cache.
+         * @param[in] compression_cache Pointer to server compressed file cache.
+         * @param[in] response_cache Pointer to server response cache.
+         * @param[in] logger Pointer to server logger.
+         * @param[in] metrics Pointer to server metrics.
+         * @param[in] addr Network address on which worker should listen.
+         * @param[in] shutdown_fd File descriptor which becomes readable when server is shutting down.
+         */
+        Worker(shared_ptr<Config> config, shared_ptr<Cache> cache, shared_ptr<ContentCache> content_cache,
+                shared_ptr<MetadataCache> metadata_cache, shared_ptr<DescriptorCache> descriptor_cache,
+                shared_ptr<ContentCache> compression_cache, shared_ptr<ContentCache> response_cache,
+                shared_ptr<Logger> logger, shared_ptr<Metrics> metrics, const struct sockaddr_in &addr,
+                const int &shutdown_fd) noexcept;
+        /**
+         * Closes all client connections, epoll instance and server socket.
+         */
+        ~Worker();
+        /**
+         * Gets non-blocking server socket file descriptor, enables its reusing by this and other workers, binds
+         * and starts listening on it. Creates epoll instance and registers server socket and m_shutdown_fd in it.
+         * Reserves spare file descriptor (m_spare_fd).
+         * @return Boolean if preparing the server socket was successful.
+         */
+        bool setup() noexcept;
+        /**
+         * Registers counters of this worker in m_metrics, setups m_request and starts event loop.
+         *
+         * Waits for edge-triggered events on server socket and all client sockets. New clients are accepted by
+         * accept_all(), readable and writable clients are driven by handle_client(), so no single slow client
+         * can block the others. Once per second closes connections idle for longer than
+         * \ref KeepaliveTimeout "keepalive_timeout" and answers requests not received completely in
+         * \ref HeaderTimeout "header_timeout" and closes connections whose responses were not sent in
+         * \ref SendTimeout "send_timeout" and reaps scripts killed by ScriptGenerator. Returns once m_shutdown_fd
+         * becomes readable.
+         * @return true if shutdown was signalled, false if epoll_wait() encountered error
+         * @see Request
+         * @see Connection
+         * @see accept_all()
+         * @see handle_client()
+         * @see check_timeouts()
+         */
+        bool run() noexcept;
+    private:
+        /** Static member holding number of active connections which should listen() use. */
+        static const int active_incoming = 128;
+        /** Static member holding maximum number of events returned by one epoll_wait(). */
+        static const int max_events = 256;
+        /** Static member holding timeout of epoll_wait() in milliseconds. */
+        static const int epoll_timeout = 1000;
+        /** Static member holding for how many seconds are data discarded from client before closing connection. */
+        static const int linger_timeout = 2;
+        /** Member holding request handler of this worker. */
+        unique_ptr<Request> m_request;
+        /** Member holding pointer to loaded configuration. */
+        shared_ptr<Config> m_config;
+        /** Member holding pointer to active cache. */
+        shared_ptr<Cache> m_cache;
+        /** Member holding pointer to active file content cache. */
+        shared_ptr<ContentCache> m_content_cache;
+        /** Member holding pointer to active file metadata cache. */
+        shared_ptr<MetadataCache> m_metadata_cache;
+        /** Member holding pointer to active open file cache. */
+        shared_ptr<DescriptorCache> m_descriptor_cache;
+        /** Member holding pointer to active cache of compressed files. */
+        shared_ptr<ContentCache> m_compression_cache;
+        /** Member holding pointer to active cache of complete responses. */
+        shared_ptr<ContentCache> m_response_cache;
+        /** Member holding pointer to active logger. */
+        shared_ptr<Logger> m_logger;
+        /** Member holding pointer to server metrics. */
+        shared_ptr<Metrics> m_metrics;
+        /** Member holding metrics counters written only by this worker. */
+        Metrics::counters *m_counters;
+        /** Member holding current logged message. */
+        string m_log_message;
+        /** Member holding for how many seconds may connection wait for next request (0 disables keep-alive). */
+        int m_keepalive_timeout;
+        /** Member holding how many requests may be handled on one connection (0 means unlimited). */
+        int m_keepalive_max_requests;
+        /** Member holding maximum size of request head in bytes. */
+        size_t m_max_header_size;
+        /** Member holding for how many seconds may client send one request head. */
+        int m_header_timeout;
+        /** Member holding for how many seconds may sending of responses make no progress. */
+        int m_send_timeout;
+        /**
+         * Struct storing information about socket used by worker.
+         */
+        struct sock {
+            /** Member holding socket file descriptor. */
+            int fd;
+            /** Member holding network address information. */
+            struct sockaddr_in addr;
+        };
+        /** Member storing socket information about worker. */
+        struct sock m_server;
+        /** Member holding file descriptor which becomes readable when server is shutting down. */
+        int m_shutdown_fd;
+        /** Member holding epoll instance file descriptor. */
+        int m_epoll_fd;
+        /**
+         * Member holding file descriptor kept open, so it can be freed to accept and close client once all others
+         * are used.
+         */
+        int m_spare_fd;
+        /** Member holding whether clients may be left in queue after accept() failed. */
+        bool m_accept_pending;
+        /** Member map holding all open client connections by their socket file descriptor. */
+        unordered_map<int, unique_ptr<Connection>> m_connections;
+        /**
+         * Member holding connections closed while handling current events. They are destroyed only after all
+         * events are handled, because one connection can get events from both its socket and its stream.
+         */
+        vector<unique_ptr<Connection>> m_closed;
+        /**
+         * Accepts all pending client connections, makes them non-blocking and registers them in epoll instance.
+         * Clients which aborted connection while waiting in queue are skipped. If no file descriptor is left,
+         * clients are refused by refuse_client(). After other errors accepting is retried by run() once per second.
+         * @note Because server socket is registered as edge-triggered, we need to accept until accept() would block.
+         */
+        void accept_all() noexcept;
+        /**
+         * Closes spare file descriptor (m_spare_fd), accepts and immediately closes one client and reserves spare
+         * file descriptor again.
+         * @return true if client was refused, false if there was no client or it cannot be accepted (errno is set
+         * by accept()).
+         */
+        bool refuse_client() noexcept;
+        /**
+         * Drives connection state machine. Receives available request data up to
+         * \ref MaxHeaderSize "max_header_size". While in READING state calls HTTP request handler on every
+         * complete (possibly pipelined) request and queues responses in order, then sends them while in WRITING
+         * state. Sent bytes and time until all queued responses are sent are counted in m_counters. Too large
+         * request head is answered with HttpConstants::CODE_HEADERS_TOO_LARGE. Closes connection once the last
+         * response is sent or on error. If client may still be sending data, connection lingers instead of being
+         * closed immediately.
+         * @param[in] connection Connection with pending event.
+         * @param[in] events Epoll events of connection.
+         * @see handle_requests()
+         */
+        void handle_client(Connection &connection, const uint32_t &events) noexcept;
+        /**
+         * Calls HTTP request handler on every complete request received on connection and queues responses.
+         * Stops after response which closes the connection.
+         * @param[in] connection Connection with received requests.
+         */
+        void handle_requests(Connection &connection) noexcept;
+        /**
+         * Closes all connections waiting for request for longer than m_keepalive_timeout. Answers connections
+         * sending request head for longer than m_header_timeout with HttpConstants::CODE_REQUEST_TIMEOUT.
+         * Closes connections lingering for longer than linger_timeout and connections whose responses made no
+         * sending progress for m_send_timeout, so client which never reads cannot hold its socket and queued
+         * responses forever. The same applies to streamed body whose generator produces no data, closing
+         * connection kills hung script and closes its pipe.
+         * @param[in] now Current time.
+         */
+        void check_timeouts(const time_t &now) noexcept;
+        /**
+         * Registers file descriptor on which streamed body of connection waits in epoll instance, so connection
+         * is driven again once more data of body are available.
+         * @param[in] connection Connection which could not send whole response.
+         * @return true if connection does not wait for stream or stream was registered, false otherwise.
+         */
+        bool watch_stream(Connection &connection) noexcept;
+        /**
+         * Removes connection from epoll instance and closes it once all current events are handled.
+         * @param[in] connection Connection to be closed.
+         */
+        void close_client(Connection &connection) noexcept;
+};
+
+
+#endif //EIRSERVER_WORKER_H
@@ -0,0 +1,147 @@
+//
+// Created by satopja2 on 17.10.26.
+//
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+
+#include "../src/server/Cache.h"
+
+using namespace std;
+
+/**
+ * Class stressing sharded Cache from many threads while its sweeper thread expires entries.
+ * @note Workers check and add random paths with short cache time and small entry limit, so entries are inserted,
+ * found, replaced, evicted and swept all at once. Cache must never accept wrong ETag and its shards must stay
+ * consistent. Test is meant to be built with ThreadSanitizer, which reports any data race.
+ */
+class CacheStressTest {
+    public:
+        /**
+         * Runs test.
+         * @param[in] threads Number of worker threads.
+         * @param[in] seconds Duration of test in seconds.
+         * @return true if cache behaved correctly, false otherwise.
+         */
+        static bool run(const size_t &threads, const int &seconds) noexcept;
+    private:
+        /** Static member holding number of distinct paths, more than cache may hold. */
+        static constexpr size_t paths_count = 4096;
+        /** Static member holding maximum number of cache entries. */
+        static constexpr size_t max_entries = 1024;
+        /**
+         * Runs in worker thread, checks and adds random paths until stop is set.
+         * @param[in] cache Tested cache.
+         * @param[in] seed Seed of random paths.
+         * @param[in] stop Whether thread should stop.
+         * @param[out] operations Number of done operations.
+         * @param[out] errors Number of wrong cache results.
+         */
+        static void work(Cache &cache, const unsigned int &seed, const atomic<bool> &stop,
+                atomic<size_t> &operations, atomic<size_t> &errors) noexcept;
+        /**
+         * Checks that every shard holds at most its share of entries and every entry is registered in timing
+         * wheel exactly where it remembers.
+         * @param[in] cache Tested cache, no thread may use it meanwhile.
+         * @return true if all shards are consistent, false otherwise.
+         */
+        static bool check_shards(Cache &cache) noexcept;
+};
+
+bool CacheStressTest::run(const size_t &threads, const int &seconds) noexcept {
+    Cache cache(1, CacheStressTest::max_entries);
+    atomic<bool> stop(false);
+    atomic<size_t> operations(0), errors(0);
+    vector<thread> workers;
+
+    for (size_t worker = 0; worker < threads; ++worker)
+        workers.emplace_back(work, ref(cache), worker, cref(stop), ref(operations), ref(errors));
+    this_thread::sleep_for(chrono::seconds(seconds));
+    stop = true;
+    for (auto &worker : workers)
+        worker.join();
+
+    printf("%zu threads, %zu operations, %zu wrong results\n", threads, operations.load(), errors.load());
+    return errors == 0 && check_shards(cache);
+}
+
+void CacheStressTest::work(Cache &cache, const unsigned int &seed, const atomic<bool> &stop,
+        atomic<size_t> &operations, atomic<size_t> &errors) noexcept {
+    mt19937 generator(seed);
+    uniform_int_distribution<size_t> path_distribution(0, CacheStressTest::paths_count - 1);
+    struct stat status = {};
+    string path, etag;
+    size_t done = 0;
+    Cache::cache_status result = Cache::OK;
+
+    while (!stop.load(memory_order_relaxed)) {
+        // Files change now and then, so entries are replaced too
+        path = "/stress/file" + to_string(path_distribution(generator));
+        status.st_mtime = path_distribution(generator) % 64 == 0 ? done : 0;
+
+        if (!cache.add_file(path, etag, status))
+            errors++;
+
+        // Entry may be evicted, swept or replaced meanwhile, but it must never match another ETag
+        result = cache.check_file(path, etag, status);
+        if (result == Cache::ERROR || (result == Cache::OK && etag != Cache::get_etag(path, status)))
+            errors++;
+        if (cache.check_file(path, "\"invalid\"", status) == Cache::OK)
+            errors++;
+        done++;
+    }
+
+    operations += done;
+    return;
+}
+
+bool CacheStressTest::check_shards(Cache &cache) noexcept {
+    size_t shard_max_entries = (CacheStressTest::max_entries + Cache::shard_count - 1) / Cache::shard_count;
+    size_t used = 0, registered = 0;
+    bool is_valid = true;
+
+    for (auto &entries_shard : cache.m_shards) {
+        used = 0;
+        for (size_t index = 0; index < entries_shard.slots.size(); ++index) {
+            const struct Cache::slot &entry_slot = entries_shard.slots[index];
+            if (!entry_slot.used)
+                continue;
+            used++;
+            // Entry has to be found by its path and registered in bucket of its tick
+            const auto &bucket = entries_shard.wheel[entry_slot.entry.tick % Cache::wheel_size];
+            if (Cache::find_slot(entries_shard, entry_slot.path_hash, entry_slot.path) != index
+                    || entry_slot.entry.wheel_pos >= bucket.size()
+                    || bucket[entry_slot.entry.wheel_pos].path != entry_slot.path)
+                is_valid = false;
+        }
+
+        registered = 0;
+        for (const auto &bucket : entries_shard.wheel)
+            registered += bucket.size();
+        if (used != entries_shard.count || registered != used || used > shard_max_entries)
+            is_valid = false;
+    }
+
+    if (!is_valid)
+        fprintf(stderr, "Cache shards are inconsistent\n");
+    return is_valid;
+}
+
+int main(int argc, char *argv[]) {
+    size_t threads = max(thread::hardware_concurrency() * 2, 8U);
+    int seconds = (argc > 1) ? atoi(argv[1]) : 5;
+
+    if (seconds <= 0) {
+        fprintf(stderr, "Usage: %s [seconds]\n", argv[0]);
+        return 1;
+    }
+
+    return CacheStressTest::run(threads, seconds) ? 0 : 1;
+}